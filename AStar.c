@@ -1,15 +1,66 @@
+#ifdef ASTAR_STATS
+#define _POSIX_C_SOURCE 199309L
+#endif
 #include "AStar.h"
 #include "IndexPriorityQueue.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <math.h>
+#ifdef ASTAR_STATS
+#include <time.h>
+#endif
 
-// Distance metrics, you might want to change these to match your game mechanics
+// Distance metrics. The estimate is picked with ASTAR_HEURISTIC (see
+// AStar.h); the precise distance follows from the step costs.
+
+#ifdef ASTAR_INTEGER_COSTS
+
+// Chebyshev distance metric for distance estimation by default, scaled
+// by the straight step cost so that it stays admissible
+static astar_cost_t estimateDistance (coord_t start, coord_t end)
+{
+	int dx = abs (start.x - end.x);
+	int dy = abs (start.y - end.y);
+#if ASTAR_HEURISTIC == ASTAR_HEURISTIC_MANHATTAN
+	return ASTAR_COST_STRAIGHT * (dx + dy);
+#elif ASTAR_HEURISTIC == ASTAR_HEURISTIC_OCTILE
+	if (dx < dy)
+		return ASTAR_COST_DIAGONAL * dx + ASTAR_COST_STRAIGHT * (dy - dx);
+	else
+		return ASTAR_COST_DIAGONAL * dy + ASTAR_COST_STRAIGHT * (dx - dy);
+#else
+	return ASTAR_COST_STRAIGHT * (dx > dy ? dx : dy);
+#endif
+}
+
+// Octile distance in fixed point. Jumps only ever go in a straight line
+// or along a diagonal, but there's no harm in handling the general case.
+static astar_cost_t preciseDistance (coord_t start, coord_t end)
+{
+	int dx = abs (start.x - end.x);
+	int dy = abs (start.y - end.y);
+	if (dx < dy)
+		return ASTAR_COST_DIAGONAL * dx + ASTAR_COST_STRAIGHT * (dy - dx);
+	else
+		return ASTAR_COST_DIAGONAL * dy + ASTAR_COST_STRAIGHT * (dx - dy);
+}
+
+#else
 
 // Chebyshev distance metric for distance estimation by default
-static double estimateDistance (coord_t start, coord_t end)
+static astar_cost_t estimateDistance (coord_t start, coord_t end)
 {
+#if ASTAR_HEURISTIC == ASTAR_HEURISTIC_MANHATTAN
+	return abs (start.x - end.x) + abs (start.y - end.y);
+#elif ASTAR_HEURISTIC == ASTAR_HEURISTIC_OCTILE
+	int dx = abs (start.x - end.x);
+	int dy = abs (start.y - end.y);
+	return fmax (dx, dy) + (sqrt (2) - 1) * fmin (dx, dy);
+#else
 	return fmax (abs (start.x - end.x), abs (start.y - end.y));
+#endif
 }
 
 // Since we only work on uniform-cost maps, this function only needs
@@ -18,36 +69,222 @@ static double estimateDistance (coord_t start, coord_t end)
 // Note that since we jump over points, we actually have to compute 
 // the entire distance - despite the uniform cost we can't just collapse
 // all costs to 1
-static double preciseDistance (coord_t start, coord_t end)
+static astar_cost_t preciseDistance (coord_t start, coord_t end)
+{
+	int dx = start.x - end.x;
+	int dy = start.y - end.y;
+	if (dx != 0 && dy != 0)
+		return sqrt (dx * dx + dy * dy);
+	else
+		return abs (dx) + abs (dy);
+}
+
+#endif
+
+// The estimate weighted searches use. Weighting a loose estimate like the
+// Chebyshev distance mostly just reorders ties, since it stays below the
+// real costs anyway, so they use the tightest admissible one whatever
+// ASTAR_HEURISTIC is: octile, or Manhattan with 4 directions.
+static astar_cost_t weightedEstimate (coord_t start, coord_t end)
 {
-	if (start.x - end.x != 0 && start.y - end.y != 0)
-		return sqrt (pow (start.x - end.x, 2) + 
-			     pow (start.y - end.y, 2)) ;
+#ifdef ASTAR_INTEGER_COSTS
+	astar_cost_t straight = ASTAR_COST_STRAIGHT, diagonal = ASTAR_COST_DIAGONAL;
+#else
+	astar_cost_t straight = 1, diagonal = sqrt (2);
+#endif
+	int dx = abs (start.x - end.x);
+	int dy = abs (start.y - end.y);
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+	(void) diagonal;
+	return straight * (dx + dy);
+#else
+	if (dx < dy)
+		return diagonal * dx + straight * (dy - dx);
 	else
-		return abs (start.x - end.x) + abs (start.y - end.y);
+		return diagonal * dy + straight * (dx - dy);
+#endif
 }
 
 // Below this point, not a lot that there should be much need to change!
 
+// Instrumentation: STAT (statement) runs the statement only when the
+// library is built with ASTAR_STATS, so the counters cost nothing otherwise.
+#ifdef ASTAR_STATS
+#define STAT(statement) statement
+
+static double now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+#else
+#define STAT(statement)
+#endif
+
 typedef int node;
 
-typedef struct astar {
+// The order of directions is: 
+// N, NE, E, SE, S, SW, W, NW 
+typedef unsigned char direction;
+#define NO_DIRECTION 8
+typedef unsigned char directionset;
+
+typedef struct astar astar_t;
+
+// finds the next jump point from a node in a given direction, or -1
+typedef int (*jump_fn) (astar_t *astar, direction dir, int start);
+
+// Where the two halves of a bidirectional search meet: the cheapest path
+// found so far through a node both have reached, and that node (-1 if
+// they haven't met yet).
+typedef struct meeting {
+	astar_cost_t cost;
+	node at;
+} meeting;
+
+struct astar {
 	const char *grid;
+	const astar_bitgrid_t *bitgrid;
+	const astar_jpsplus_t *jpsplus;
+	const astar_neighbours_t *neighbours;
+	const astar_landmarks_t *landmarks;
+	jump_fn jump;
 	coord_t bounds;
 	node start;
 	node goal;
 	queue *open;
-	char *closed;
-	double *gScores;
+	unsigned int *closed;
+	unsigned int generation;
+	astar_cost_t *gScores;
 	node *cameFrom;
+	direction *arrival;
+	// the goal's coordinates, if there is a goal
+	coord_t goalCoord;
+	// what the estimate is multiplied by in priorities
+	double weight;
+	// with a weight above 1, the directions each node has been reached
+	// from, and those it has jumped in (see reachWeighted); NULL otherwise
+	directionset *arrivals;
+	directionset *jumped;
 	int *solutionLength;
-} astar_t;
-
-// The order of directions is: 
-// N, NE, E, SE, S, SW, W, NW 
-typedef unsigned char direction;
-#define NO_DIRECTION 8
-typedef unsigned char directionset;
+	astar_stats_t *stats;
+	// the allocator paths come from, and whether the open list couldn't
+	// take a node, after which the search can't be trusted to go on
+	const astar_allocator_t *alloc;
+	int outOfMemory;
+	// in a bidirectional search, the search going the other way
+	astar_t *other;
+	meeting *meeting;
+	// in a multi-goal search, where goal is -1, the goals are the nodes
+	// stamped with the current generation here
+	const unsigned int *goalMarks;
+};
+
+// The per-map search state that astar_t borrows for the duration of a
+// query. A node counts as closed only when its stamp in closed equals the
+// current generation, so starting a new query is a counter bump instead of
+// a memset over the whole map. gScores and cameFrom are only ever read for
+// nodes that are open or closed in the current query, so they need no
+// clearing at all.
+struct astar_context {
+	coord_t bounds;
+	queue *open;
+	unsigned int *closed;
+	unsigned int generation;
+	astar_cost_t *gScores;
+	node *cameFrom;
+	// the direction of the last step into each node, i.e. the one from
+	// cameFrom to it
+	direction *arrival;
+	// only allocated once the context is used for a multi-goal search
+	unsigned int *goalMarks;
+	const astar_components_t *components;
+	const astar_landmarks_t *landmarks;
+	double weight;
+	// only allocated once the context is given a weight above 1
+	directionset *arrivals;
+	directionset *jumped;
+	astar_stats_t stats;
+	astar_allocator_t alloc;
+	// where the paths returned come from, alloc unless set otherwise
+	astar_allocator_t pathAlloc;
+};
+
+// A search that's run a bit at a time. It has a context all to itself
+// until it's finished, either its own or one lent by the caller.
+struct astar_search {
+	astar_t astar;
+	astar_context_t *ctx;
+	int ownsContext;
+	int solutionLength;
+	astar_status_t status;
+};
+
+// One bit per cell, set if the cell is enterable, stored twice: row by row,
+// and column by column so that vertical scans get to read whole words too.
+// Bits past the end of a row or column are always clear.
+struct astar_bitgrid {
+	coord_t bounds;
+	int rowWords;
+	int colWords;
+	uint64_t *rows;
+	uint64_t *cols;
+};
+
+// One byte per cell with a bit for each of its 8 neighbours, set if that
+// neighbour is on the map and enterable, and for every such byte and
+// direction of travel the forced neighbours that go with it, so that
+// finding them is a single lookup.
+struct astar_neighbours {
+	coord_t bounds;
+	unsigned char *masks;
+	directionset forced[256][8];
+};
+
+// JPS+ distance tables. For every cell and every direction there's one
+// entry: if it's positive, it's the number of steps to the next jump point
+// in that direction, i.e. to the node jump() would return if the goal
+// weren't in the way; otherwise its absolute value is the number of
+// enterable cells before a wall or the map edge. ownDistances is set
+// when we computed the tables ourselves, and NULL when they're borrowed.
+struct astar_jpsplus {
+	const char *grid;
+	coord_t bounds;
+	const int *distances;
+	int *ownDistances;
+};
+
+// ALT landmark tables. The block is also their saved form: a
+// landmarkHeader, a scale for each landmark, and then for every cell its
+// distances to the landmarks in turn, either as costs, -1 where there's no
+// path, or if quantized as 16-bit multiples of the landmark's scale,
+// rounded down, UINT16_MAX where there's no path. ownBlock is set when we
+// computed the tables ourselves, and NULL when they're borrowed.
+typedef struct landmarkHeader {
+	uint32_t count;
+	uint32_t quantized;
+	uint32_t costSize;
+	uint32_t layout;
+	int32_t boundX;
+	int32_t boundY;
+	// keeps the tables after the header 8-byte aligned
+	uint64_t reserved;
+} landmarkHeader;
+
+struct astar_landmarks {
+	coord_t bounds;
+	int count;
+	int quantized;
+	const astar_cost_t *costs;
+	const uint16_t *steps;
+	// for quantized tables, the estimate a difference of one step is
+	// worth for each landmark (see landmarkEstimate)
+	double *stepEstimates;
+	const void *block;
+	size_t size;
+	void *ownBlock;
+};
 
 // return and remove a direction from the set
 // returns NO_DIRECTION if the set was empty
@@ -70,15 +307,66 @@ static directionset addDirectionToSet (directionset dirs, direction dir)
 
 /* Coordinates are represented either as pairs of an x-coordinate and
    y-coordinate, or map indexes, as appropriate. getIndex and getCoord
-   convert between the representations. */
+   convert between the representations, in the layout picked with
+   ASTAR_LAYOUT (see AStar.h), and moveIndex steps an index by a few cells
+   without going through coordinates. */
+#if ASTAR_LAYOUT == ASTAR_LAYOUT_TILED
+
+#define TILE_CELLS (ASTAR_TILE_SIZE * ASTAR_TILE_SIZE)
+
+static int tilesAcross (int width)
+{
+	return (width + ASTAR_TILE_SIZE - 1) / ASTAR_TILE_SIZE;
+}
+
+// coordinates are never negative here, so the divisions and remainders
+// are shifts and masks
 static int getIndex (coord_t bounds, coord_t c)
 {
-	return c.x + c.y * bounds.x;
+	unsigned x = c.x, y = c.y;
+	return ((y / ASTAR_TILE_SIZE) * tilesAcross (bounds.x) + x / ASTAR_TILE_SIZE) * TILE_CELLS +
+		(y % ASTAR_TILE_SIZE) * ASTAR_TILE_SIZE + x % ASTAR_TILE_SIZE;
 }
 
-int astar_getIndexByWidth (int width, int x, int y)
+static coord_t getCoord (coord_t bounds, int c)
+{
+	unsigned tile = (unsigned) c / TILE_CELLS, within = (unsigned) c % TILE_CELLS;
+	unsigned across = tilesAcross (bounds.x);
+	coord_t rv = { tile % across * ASTAR_TILE_SIZE + within % ASTAR_TILE_SIZE,
+		       tile / across * ASTAR_TILE_SIZE + within / ASTAR_TILE_SIZE };
+	return rv;
+}
+
+// Within a tile this is the row-major step; off its edge, it's on to the
+// next tile along, or the next row of tiles. dx and dy are -1, 0 or 1, and
+// constant in the loops this is used in, so the branches are predictable.
+static inline int moveIndex (coord_t bounds, int node, int dx, int dy)
+{
+	int x = (unsigned) node % ASTAR_TILE_SIZE;
+	int y = (unsigned) node / ASTAR_TILE_SIZE % ASTAR_TILE_SIZE;
+	if (dx > 0)
+		node += x == ASTAR_TILE_SIZE - 1 ? TILE_CELLS - x : 1;
+	else if (dx < 0)
+		node -= x == 0 ? TILE_CELLS - (ASTAR_TILE_SIZE - 1) : 1;
+	if (dy > 0)
+		node += y == ASTAR_TILE_SIZE - 1 ? 
+			tilesAcross (bounds.x) * TILE_CELLS - y * ASTAR_TILE_SIZE : ASTAR_TILE_SIZE;
+	else if (dy < 0)
+		node -= y == 0 ? 
+			tilesAcross (bounds.x) * TILE_CELLS - (TILE_CELLS - ASTAR_TILE_SIZE) : ASTAR_TILE_SIZE;
+	return node;
+}
+
+static int layoutSize (coord_t bounds)
+{
+	return tilesAcross (bounds.x) * tilesAcross (bounds.y) * TILE_CELLS;
+}
+
+#else
+
+static int getIndex (coord_t bounds, coord_t c)
 {
-	return x + y * width;
+	return c.x + c.y * bounds.x;
 }
 
 static coord_t getCoord (coord_t bounds, int c)
@@ -87,10 +375,33 @@ static coord_t getCoord (coord_t bounds, int c)
 	return rv;
 }
 
+static inline int moveIndex (coord_t bounds, int node, int dx, int dy)
+{
+	return node + dx + dy * bounds.x;
+}
+
+static int layoutSize (coord_t bounds)
+{
+	return bounds.x * bounds.y;
+}
+
+#endif
+
+int astar_getIndexByWidth (int width, int x, int y)
+{
+	return getIndex ((coord_t) {width, 0}, (coord_t) {x, y});
+}
+
 void astar_getCoordByWidth (int width, int node, int *x, int *y)
 {
-	*x = node % width;
-	*y = node / width;
+	coord_t c = getCoord ((coord_t) {width, 0}, node);
+	*x = c.x;
+	*y = c.y;
+}
+
+int astar_layout_size (int boundX, int boundY)
+{
+	return layoutSize ((coord_t) {boundX, boundY});
 }
 
 
@@ -100,12 +411,22 @@ static int contained (coord_t bounds, coord_t c)
 	return c.x >= 0 && c.y >= 0 && c.x < bounds.x && c.y < bounds.y;
 }
 
+static int bitgridGet (const astar_bitgrid_t *bitgrid, coord_t coord)
+{
+	const uint64_t *row = bitgrid->rows + coord.y * bitgrid->rowWords;
+	return (row[coord.x / 64] >> (coord.x % 64)) & 1;
+}
+
 // is this coordinate within the map bounds, and also walkable?
 static int isEnterable (astar_t *astar, coord_t coord)
 {
-	node node = getIndex (astar->bounds, coord);
-	return contained (astar->bounds, coord) && 
-		astar->grid[node];
+	if (!contained (astar->bounds, coord))
+		return 0;
+
+	if (astar->bitgrid)
+		return bitgridGet (astar->bitgrid, coord);
+
+	return astar->grid[getIndex (astar->bounds, coord)];
 }
 
 static int directionIsDiagonal (direction dir)
@@ -133,6 +454,21 @@ static coord_t adjustInDirection (coord_t c, int dir)
 	return (coord_t) { -1, -1 };
 }
 
+// can we take a single step from c in the given direction?
+static int canStep (astar_t *astar, coord_t c, direction dir)
+{
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+	if (directionIsDiagonal (dir))
+		return 0;
+#elif ASTAR_MOVEMENT == ASTAR_MOVE_NO_CORNER_CUTTING
+	if (directionIsDiagonal (dir) &&
+	    (!isEnterable (astar, adjustInDirection (c, (dir + 7) % 8)) ||
+	     !isEnterable (astar, adjustInDirection (c, (dir + 1) % 8))))
+		return 0;
+#endif
+	return isEnterable (astar, adjustInDirection (c, dir));
+}
+
 // logical implication operator
 static int implies (int a, int b)
 {
@@ -209,6 +545,29 @@ static directionset forcedNeighbours (astar_t *astar,
 	directionset dirs = 0;
 #define ENTERABLE(n) isEnterable (astar, \
 				  adjustInDirection (coord, (dir + (n)) % 8))
+#if ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL
+	// Without corner cutting, a straight neighbour is forced where the
+	// cell behind it is blocked, since the way round the corner to it is
+	// through us; so is the diagonal past it, which would otherwise be
+	// reached round the same corner. A diagonal move can't pass a
+	// blocked cell at all, so diagonals have no forced neighbours.
+	if (!directionIsDiagonal (dir)) {
+		if (!implies (ENTERABLE (6), ENTERABLE (5))) {
+			dirs = addDirectionToSet (dirs, (dir + 6) % 8);
+			if (ASTAR_MOVEMENT == ASTAR_MOVE_NO_CORNER_CUTTING)
+				dirs = addDirectionToSet (dirs, (dir + 7) % 8);
+		}
+		if (!implies (ENTERABLE (2), ENTERABLE (3))) {
+			dirs = addDirectionToSet (dirs, (dir + 2) % 8);
+			if (ASTAR_MOVEMENT == ASTAR_MOVE_NO_CORNER_CUTTING)
+				dirs = addDirectionToSet (dirs, (dir + 1) % 8);
+		}
+	}
+#else
+	if (astar->neighbours)
+		return astar->neighbours->forced[astar->neighbours->masks[
+			getIndex (astar->bounds, coord)]][dir];
+
 	if (directionIsDiagonal (dir)) {
 		if (!implies (ENTERABLE (6), ENTERABLE (5)))
 			dirs = addDirectionToSet (dirs, (dir + 6) % 8);
@@ -221,12 +580,22 @@ static directionset forcedNeighbours (astar_t *astar,
 		if (!implies (ENTERABLE (1), ENTERABLE (2)))
 			dirs = addDirectionToSet (dirs, (dir + 1) % 8);
 	}	
+#endif
 #undef ENTERABLE	
 	return dirs;
 }
 
 static directionset naturalNeighbours (direction dir)
 {
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+	// vertical jumps stop wherever a horizontal one would find something,
+	// so both sideways directions have to be looked at from there
+	if (dir == NO_DIRECTION)
+		return 0x55;
+	return addDirectionToSet (addDirectionToSet (addDirectionToSet (0, dir), 
+						     (dir + 2) % 8), 
+				  (dir + 6) % 8);
+#else
 	if (dir == NO_DIRECTION)
 		return 255;
 
@@ -237,331 +606,2667 @@ static directionset naturalNeighbours (direction dir)
 		dirs = addDirectionToSet (dirs, (dir + 7) % 8);
 	}
 	return dirs;
+#endif
+}
+
+// the x and y steps of a move in the given direction
+static coord_t directionDelta (direction dir)
+{
+	return adjustInDirection ((coord_t) {0, 0}, dir);
+}
+
+/* The landmark estimate of the cost from node to goal: the largest
+   difference between their distances to any one landmark.
+
+   Quantized distances may each have been rounded down by up to a step of
+   their landmark's scale s, so the difference is taken one step lower.
+   That's still a lower bound, but not quite consistent: across a move of
+   cost c it can change by up to c + s. Scaling it by c / (c + s) for the
+   cheapest move c makes it consistent again, and that's folded into
+   stepEstimates. */
+static astar_cost_t landmarkEstimate (const astar_landmarks_t *landmarks, int node, int goal)
+{
+	int count = landmarks->count;
+	if (landmarks->quantized) {
+		const uint16_t *a = landmarks->steps + (size_t) node * count;
+		const uint16_t *b = landmarks->steps + (size_t) goal * count;
+		double best = 0;
+		for (int i = 0; i < count; i++) {
+			if (a[i] == UINT16_MAX || b[i] == UINT16_MAX)
+				continue;
+			double estimate = (abs (a[i] - b[i]) - 1) * landmarks->stepEstimates[i];
+			if (estimate > best)
+				best = estimate;
+		}
+		// rounded down with integer costs
+		return best;
+	}
+
+	const astar_cost_t *a = landmarks->costs + (size_t) node * count;
+	const astar_cost_t *b = landmarks->costs + (size_t) goal * count;
+	astar_cost_t best = 0;
+	for (int i = 0; i < count; i++) {
+		if (a[i] < 0 || b[i] < 0)
+			continue;
+		astar_cost_t estimate = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+		if (estimate > best)
+			best = estimate;
+	}
+	return best;
+}
+
+// the estimate part of a node's priority
+static double priorityEstimate (const astar_t *astar, int node, coord_t c)
+{
+	astar_cost_t estimate = astar->weight == 1 ? estimateDistance (c, astar->goalCoord)
+		: weightedEstimate (c, astar->goalCoord);
+	if (astar->landmarks) {
+		astar_cost_t alt = landmarkEstimate (astar->landmarks, node, astar->goal);
+		if (alt > estimate)
+			estimate = alt;
+	}
+	return astar->weight == 1 ? estimate : astar->weight * estimate;
+}
+
+// Open list changes that there isn't the memory for stop the search, since
+// going on without the node could give a wrong answer.
+static void openInsert (astar_t *astar, int node, double priority)
+{
+	if (insert (astar->open, node, priority))
+		astar->outOfMemory = 1;
+}
+
+static void openChange (astar_t *astar, int node, double priority)
+{
+	if (changePriority (astar->open, node, priority))
+		astar->outOfMemory = 1;
 }
 
+// Add node, reached from nodeFrom at nodeFromCoord by a straight or diagonal
+// line in direction dir. The number of steps along the line is the
+// difference of the indexes over the index step of dir, which gives node's
+// coordinates without getCoord's divide and modulo. Tiled indexes don't
+// step evenly, so there it's getCoord after all.
 static void addToOpenSet (astar_t *astar,
 			  int node, 
-			  int nodeFrom)
+			  int nodeFrom,
+			  coord_t nodeFromCoord,
+			  direction dir)
 {
+#if ASTAR_LAYOUT == ASTAR_LAYOUT_TILED
 	coord_t nodeCoord = getCoord (astar->bounds, node);
-	coord_t nodeFromCoord = getCoord (astar->bounds, nodeFrom);
+#else
+	coord_t delta = directionDelta (dir);
+	int steps = delta.y ? (node - nodeFrom) / (delta.x + delta.y * astar->bounds.x)
+			    : (node - nodeFrom) * delta.x;
+	coord_t nodeCoord = {nodeFromCoord.x + steps * delta.x, 
+			     nodeFromCoord.y + steps * delta.y};
+#endif
+
+	astar_cost_t gScore = astar->gScores[nodeFrom] + 
+		preciseDistance (nodeFromCoord, nodeCoord);
 
 	if (!exists (astar->open, node)) {
 		astar->cameFrom[node] = nodeFrom;
-		astar->gScores[node] = astar->gScores[nodeFrom] + 
-			preciseDistance (nodeFromCoord, nodeCoord);
-		insert (astar->open, node, astar->gScores[node] + 
-			estimateDistance (nodeCoord, 
-					  getCoord (astar->bounds, astar->goal)));
-	}
-	else if (astar->gScores[node] > 
-		 astar->gScores[nodeFrom] + 
-		 preciseDistance (nodeFromCoord, nodeCoord)) {
+		astar->arrival[node] = dir;
+		astar->gScores[node] = gScore;
+		// with no single goal to head for, it's plain Dijkstra
+		openInsert (astar, node, gScore + (astar->goal < 0 ? 0 :
+			    priorityEstimate (astar, node, nodeCoord)));
+		STAT (astar->stats->inserts++);
+		STAT (if (astar->open->size > astar->stats->peakOpen)
+			      astar->stats->peakOpen = astar->open->size);
+	}
+	else if (astar->gScores[node] > gScore) {
 		astar->cameFrom[node] = nodeFrom;
-		int oldGScore = astar->gScores[node];
-		astar->gScores[node] = astar->gScores[nodeFrom] + 
-			preciseDistance (nodeFromCoord, nodeCoord);
+		astar->arrival[node] = dir;
+		astar_cost_t oldGScore = astar->gScores[node];
+		astar->gScores[node] = gScore;
 		double newPri = priorityOf (astar->open, node)
 			- oldGScore
-			+ astar->gScores[node];
-		changePriority (astar->open, node, newPri);
+			+ gScore;
+		openChange (astar, node, newPri);
+		STAT (astar->stats->changePriorities++);
 	}	
 }
 
 
-// directly translated from "algorithm 2" in the paper
-static int jump (astar_t *astar, direction dir, int start)
+#if ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL
+
+/* jump() under the stricter movement rules. A straight jump stops at the
+   forced neighbours forcedNeighbours finds; a diagonal one checks both of
+   the cells it passes between before every step, and stops wherever a
+   straight probe to either side finds something. With 4 directions there
+   are no diagonals, and vertical jumps probe sideways instead. */
+static inline int isJumpGoal (astar_t *astar, int node, int multi)
 {
-	coord_t coord = adjustInDirection (getCoord (astar->bounds, start), dir);
-	int node = getIndex (astar->bounds, coord);
-	if (!isEnterable (astar, coord))
-		return -1;
+	return multi ? astar->goalMarks[node] == astar->generation
+		     : node == astar->goal;
+}
+
+static inline int jumpGrid (astar_t *astar, direction dir, int start, int multi)
+{
+	coord_t c = getCoord (astar->bounds, start);
+	for (;;) {
+		STAT (astar->stats->cellsScanned++);
+		coord_t next = adjustInDirection (c, dir);
+		if (!isEnterable (astar, next))
+			return -1;
+		if (directionIsDiagonal (dir) &&
+		    (!isEnterable (astar, adjustInDirection (c, (dir + 7) % 8)) ||
+		     !isEnterable (astar, adjustInDirection (c, (dir + 1) % 8))))
+			return -1;
+
+		c = next;
+		int node = getIndex (astar->bounds, c);
+		if (isJumpGoal (astar, node, multi) || 
+		    forcedNeighbours (astar, c, dir))
+			return node;
 
-	if (node == astar->goal || 
-	    forcedNeighbours (astar, coord, dir)) {
-		return node;
+		if (directionIsDiagonal (dir)) {
+			if (jumpGrid (astar, (dir + 7) % 8, node, multi) >= 0 ||
+			    jumpGrid (astar, (dir + 1) % 8, node, multi) >= 0)
+				return node;
+		}
+		else if (ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT && dir % 4 == 0) {
+			if (jumpGrid (astar, 2, node, multi) >= 0 ||
+			    jumpGrid (astar, 6, node, multi) >= 0)
+				return node;
+		}
 	}
+}
 
-	if (directionIsDiagonal (dir)) {
-		int next = jump (astar, (dir + 7) % 8, node);
-		if (next >= 0)
+#else
+
+/* jump() from "algorithm 2" in the paper, without the recursion. The paper
+   recurses once per step, and on every diagonal step twice more for the
+   straight probes; here each probe is a loop of its own that steps by an
+   index delta over the plain grid, having worked out once, before it
+   starts, how many steps it can take before it falls off the map and
+   which of its two sides are on the map at all. That leaves the inner loop
+   with nothing to do but read cells. The diagonal does the same for its
+   own steps, so neither needs isEnterable or adjustInDirection.
+
+   multi is a constant at both call sites, so each gets its own copy with
+   the goal test folded in. */
+static inline int isJumpGoal (astar_t *astar, int node, int multi)
+{
+	return multi ? astar->goalMarks[node] == astar->generation
+		     : node == astar->goal;
+}
+
+// the next jump point in a straight line from c, or -1
+static inline int jumpStraight (astar_t *astar, direction dir, coord_t c, int multi)
+{
+	const char *grid = astar->grid;
+	coord_t bounds = astar->bounds;
+	coord_t d = directionDelta (dir);
+	// side: a step across the line
+	coord_t side;
+	int steps, hasLeft, hasRight;
+	if (d.x) {
+		steps = d.x > 0 ? bounds.x - 1 - c.x : c.x;
+		side = (coord_t) {0, 1};
+		hasLeft = c.y > 0;
+		hasRight = c.y + 1 < bounds.y;
+	}
+	else {
+		steps = d.y > 0 ? bounds.y - 1 - c.y : c.y;
+		side = (coord_t) {1, 0};
+		hasLeft = c.x > 0;
+		hasRight = c.x + 1 < bounds.x;
+	}
+
+	int node = getIndex (bounds, c);
+	for (int i = 1; i <= steps; i++) {
+		STAT (astar->stats->cellsScanned++);
+		node = moveIndex (bounds, node, d.x, d.y);
+		if (!grid[node])
+			return -1;
+		if (isJumpGoal (astar, node, multi))
 			return node;
-		next = jump (astar, (dir + 1) % 8, node);
-		if (next >= 0)
+		// a wall beside us that ends just ahead leaves a forced
+		// neighbour round its corner
+		if (i < steps &&
+		    ((hasLeft && !grid[moveIndex (bounds, node, -side.x, -side.y)] && 
+		      grid[moveIndex (bounds, node, d.x - side.x, d.y - side.y)]) ||
+		     (hasRight && !grid[moveIndex (bounds, node, side.x, side.y)] && 
+		      grid[moveIndex (bounds, node, d.x + side.x, d.y + side.y)])))
 			return node;
 	}
-	return jump (astar, dir, node);
+	// the step off the edge of the map
+	STAT (astar->stats->cellsScanned++);
+	return -1;
 }
 
-// path interpolation between jump points in here
-static int nextNodeInSolution (astar_t *astar,
-			       int *target,
-			       int node)
+static inline int jumpGrid (astar_t *astar, direction dir, int start, int multi)
 {
-	coord_t c = getCoord (astar->bounds, node);
-	coord_t cTarget = getCoord (astar->bounds, *target);
-
-	if (c.x < cTarget.x) 
-		c.x++;
-	else if (c.x > cTarget.x)
-		c.x--;
+	coord_t c = getCoord (astar->bounds, start);
+	if (!directionIsDiagonal (dir))
+		return jumpStraight (astar, dir, c, multi);
+
+	const char *grid = astar->grid;
+	coord_t bounds = astar->bounds;
+	coord_t d = directionDelta (dir);
+	int stepsX = d.x > 0 ? bounds.x - 1 - c.x : c.x;
+	int stepsY = d.y > 0 ? bounds.y - 1 - c.y : c.y;
+	int steps = stepsX < stepsY ? stepsX : stepsY;
+	int node = start;
+
+	for (int i = 1; i <= steps; i++) {
+		STAT (astar->stats->cellsScanned++);
+		node = moveIndex (bounds, node, d.x, d.y);
+		c.x += d.x;
+		c.y += d.y;
+		if (!grid[node])
+			return -1;
+		if (isJumpGoal (astar, node, multi))
+			return node;
 
-	if (c.y < cTarget.y) 
-		c.y++;
-	else if (c.y > cTarget.y)
-		c.y--;
+		// forced neighbours: behind us on one side blocked, and the
+		// cell past it enterable, on either side
+		int aheadX = c.x + d.x >= 0 && c.x + d.x < bounds.x;
+		int aheadY = c.y + d.y >= 0 && c.y + d.y < bounds.y;
+		if ((aheadY && !grid[moveIndex (bounds, node, -d.x, 0)] && 
+		     grid[moveIndex (bounds, node, -d.x, d.y)]) ||
+		    (aheadX && !grid[moveIndex (bounds, node, 0, -d.y)] && 
+		     grid[moveIndex (bounds, node, d.x, -d.y)]))
+			return node;
 
-	node = getIndex (astar->bounds, c);
+		if (jumpStraight (astar, (dir + 7) % 8, c, multi) >= 0 ||
+		    jumpStraight (astar, (dir + 1) % 8, c, multi) >= 0)
+			return node;
+	}
+	STAT (astar->stats->cellsScanned++);
+	return -1;
+}
 
-	if (node == *target)
-		*target = astar->cameFrom[*target];
+#endif
 
-	return node;
+static int jump (astar_t *astar, direction dir, int start)
+{
+	return jumpGrid (astar, dir, start, 0);
 }
 
-// a bit more complex than the usual A* solution-recording method,
-// due to the need to interpolate path chunks
-static int *recordSolution (astar_t *astar)
+// jump() for multi-goal searches, stopping at every goal
+static int jumpMulti (astar_t *astar, direction dir, int start)
 {
-	int rvLen = 1;
-	*astar->solutionLength = 0;
-	int target = astar->goal;
-	int *rv = malloc (rvLen * sizeof (int));
-	int i = astar->goal;
+	return jumpGrid (astar, dir, start, 1);
+}
 
+// jump() over the neighbourhood masks. A cell's mask says whether the next
+// cell is enterable, and the next cell's mask whether it has forced
+// neighbours, so a step is one load and one table lookup, and the map edge
+// takes care of itself.
+static int jumpMaskStraight (astar_t *astar, direction dir, int node)
+{
+	const unsigned char *masks = astar->neighbours->masks;
+	const directionset (*forced)[8] = astar->neighbours->forced;
+	coord_t d = directionDelta (dir);
+	int step = d.x + d.y * astar->bounds.x;
 	for (;;) {
-		i = nextNodeInSolution (astar, &target, i);
-		rv[*astar->solutionLength] = i;
-		(*astar->solutionLength)++;
-		if (*astar->solutionLength >= rvLen) {
-			rvLen *= 2;
-			rv = realloc (rv, rvLen * sizeof (int));
-			if (!rv)
-				return NULL;
-		}
-		if (i == astar->start)
-			break;
+		STAT (astar->stats->cellsScanned++);
+		if (!(masks[node] >> dir & 1))
+			return -1;
+		node += step;
+		if (node == astar->goal || forced[masks[node]][dir])
+			return node;
 	}
-
-	(*astar->solutionLength)--; // don't include the starting tile
-	return rv;
 }
 
-
-static direction directionOfMove (coord_t to, coord_t from)
+static int jumpMasks (astar_t *astar, direction dir, int start)
 {
-	if (from.x == to.x) {
-		if (from.y == to.y)
+	if (!directionIsDiagonal (dir))
+		return jumpMaskStraight (astar, dir, start);
+
+	const unsigned char *masks = astar->neighbours->masks;
+	const directionset (*forced)[8] = astar->neighbours->forced;
+	coord_t d = directionDelta (dir);
+	int step = d.x + d.y * astar->bounds.x;
+	int node = start;
+	for (;;) {
+		STAT (astar->stats->cellsScanned++);
+		if (!(masks[node] >> dir & 1))
 			return -1;
-		else if (from.y < to.y)
-			return 4;
-		else // from.y > to.y
-			return 0;
-	}
-	else if (from.x < to.x) {
-		if (from.y == to.y)
-			return 2;
-		else if (from.y < to.y)
-			return 3;
-		else // from.y > to.y
-			return 1;
-	}
-	else { // from.x > to.x
-		if (from.y == to.y)
-			return 6;
-		else if (from.y < to.y)
-			return 5;
-		else // from.y > to.y
-			return 7;
+		node += step;
+		if (node == astar->goal || forced[masks[node]][dir] ||
+		    jumpMaskStraight (astar, (dir + 7) % 8, node) >= 0 ||
+		    jumpMaskStraight (astar, (dir + 1) % 8, node) >= 0)
+			return node;
 	}
-
 }
 
-static direction directionWeCameFrom (astar_t *astar, int node, int nodeFrom)
+// the mask of the cell at c, from scratch
+static unsigned char neighbourMask (const char *grid, coord_t bounds, coord_t c)
 {
-	if (nodeFrom == -1)
-		return NO_DIRECTION;
-
-	return directionOfMove (getCoord (astar->bounds, node), 
-				getCoord (astar->bounds, nodeFrom));
+	unsigned char mask = 0;
+	for (int dir = 0; dir < 8; dir++) {
+		coord_t n = adjustInDirection (c, dir);
+		if (contained (bounds, n) && grid[getIndex (bounds, n)])
+			mask |= 1 << dir;
+	}
+	return mask;
 }
 
-static int init_astar_object (astar_t* astar, const char *grid, int *solLength, int boundX, int boundY, int start, int end)
+astar_neighbours_t *astar_neighbours_create (const char *grid, 
+					     int boundX, 
+					     int boundY)
 {
-	*solLength = -1;
-	coord_t bounds = {boundX, boundY};
+#if ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL || ASTAR_LAYOUT != ASTAR_LAYOUT_ROW_MAJOR
+	return NULL;
+#endif
+	if (boundX <= 0 || boundY <= 0)
+		return NULL;
 
-	int size = bounds.x * bounds.y;
+	astar_neighbours_t *neighbours = malloc (sizeof (astar_neighbours_t));
+	if (!neighbours)
+		return NULL;
 
-	if (start >= size || start < 0 || end >= size || end < 0)
-		return 0;
+	coord_t bounds = {boundX, boundY};
+	neighbours->bounds = bounds;
+	neighbours->masks = malloc ((size_t) boundX * boundY);
+	if (!neighbours->masks) {
+		free (neighbours);
+		return NULL;
+	}
 
-	coord_t startCoord = getCoord (bounds, start);
-	coord_t endCoord = getCoord (bounds, end);
+	for (int y = 0; y < boundY; y++)
+		for (int x = 0; x < boundX; x++)
+			neighbours->masks[getIndex (bounds, (coord_t) {x, y})] =
+				neighbourMask (grid, bounds, (coord_t) {x, y});
+
+	// the same rules as forcedNeighbours, reading the mask instead of
+	// the grid
+	for (int mask = 0; mask < 256; mask++)
+		for (int dir = 0; dir < 8; dir++) {
+#define ENTERABLE(n) ((mask >> ((dir + (n)) % 8)) & 1)
+			directionset dirs = 0;
+			if (directionIsDiagonal (dir)) {
+				if (!implies (ENTERABLE (6), ENTERABLE (5)))
+					dirs = addDirectionToSet (dirs, (dir + 6) % 8);
+				if (!implies (ENTERABLE (2), ENTERABLE (3)))
+					dirs = addDirectionToSet (dirs, (dir + 2) % 8);
+			}
+			else {
+				if (!implies (ENTERABLE (7), ENTERABLE (6)))
+					dirs = addDirectionToSet (dirs, (dir + 7) % 8);
+				if (!implies (ENTERABLE (1), ENTERABLE (2)))
+					dirs = addDirectionToSet (dirs, (dir + 1) % 8);
+			}
+#undef ENTERABLE
+			neighbours->forced[mask][dir] = dirs;
+		}
 
-	if (!contained (bounds, startCoord) || !contained (bounds, endCoord))
-		return 0;
+	return neighbours;
+}
 
-	astar->solutionLength = solLength;
-	astar->bounds = bounds;
-	astar->start = start;
-	astar->goal = end;
-	astar->grid = grid;
+// a cell only appears in its neighbours' masks, so that's all there is to
+// patch
+void astar_neighbours_set (astar_neighbours_t *neighbours, int x, int y, int enterable)
+{
+	for (int dir = 0; dir < 8; dir++) {
+		coord_t n = adjustInDirection ((coord_t) {x, y}, dir);
+		if (!contained (neighbours->bounds, n))
+			continue;
+
+		unsigned char bit = 1 << (dir + 4) % 8;
+		unsigned char *mask = &neighbours->masks[getIndex (neighbours->bounds, n)];
+		if (enterable)
+			*mask |= bit;
+		else
+			*mask &= ~bit;
+	}
+}
 
-	astar->open = createQueue();
-	if (!astar->open)
-		return 0;
+void astar_neighbours_free (astar_neighbours_t *neighbours)
+{
+	if (!neighbours)
+		return;
 
-	astar->closed = malloc (size);
-	if (!astar->closed) {
-		freeQueue (astar->open);
-		return 0;
-	}
+	free (neighbours->masks);
+	free (neighbours);
+}
 
-	astar->gScores = malloc (size * sizeof (double));
-	if (!astar->gScores) {
-		freeQueue (astar->open);
-		free (astar->closed);
-		return 0;
+// jump() by table lookup. The tables don't know about the goal, so we
+// still have to check whether the goal lies on the way to the next jump
+// point: directly on a straight line, or, for a diagonal, on one of the
+// straight lines that jump() would probe from the diagonal's cells.
+static int jumpPlus (astar_t *astar, direction dir, int start)
+{
+	const int *distances = astar->jpsplus->distances;
+	int dist = distances[start * 8 + dir];
+	int reach = dist > 0 ? dist : -dist;
+	coord_t delta = directionDelta (dir);
+	coord_t c = getCoord (astar->bounds, start);
+	coord_t goal = getCoord (astar->bounds, astar->goal);
+	// how many steps towards the goal along each axis, if we're headed
+	// that way at all
+	int kx = (goal.x - c.x) * delta.x;
+	int ky = (goal.y - c.y) * delta.y;
+
+	if (!directionIsDiagonal (dir)) {
+		int k = delta.x ? kx : ky;
+		int aligned = delta.x ? goal.y == c.y : goal.x == c.x;
+		if (aligned && k > 0 && k <= reach)
+			return astar->goal;
 	}
-
-	astar->cameFrom = malloc (size * sizeof (int));
-	if (!astar->cameFrom) {
-		freeQueue (astar->open);
-		free (astar->closed);
-		free (astar->gScores);
-		return 0;
+	else if (kx > 0 && ky > 0) {
+		int k = kx < ky ? kx : ky;
+		if (k <= reach && (dist <= 0 || k < dist)) {
+			coord_t ck = {c.x + k * delta.x, c.y + k * delta.y};
+			int nk = getIndex (astar->bounds, ck);
+			if (kx == ky)
+				return nk;
+
+			// the one of the two straight probes that runs along
+			// the goal's row or column
+			direction probe = (dir + 1) % 8;
+			if ((directionDelta (probe).x != 0) != (kx > ky))
+				probe = (dir + 7) % 8;
+
+			int probeDist = distances[nk * 8 + probe];
+			int remaining = (kx > ky ? kx : ky) - k;
+			if (probeDist > 0 || remaining <= -probeDist)
+				return nk;
+		}
 	}
 
-	memset (astar->closed, 0, size);
+	if (dist <= 0)
+		return -1;
 
-	astar->gScores[start] = 0;
-	astar->cameFrom[start] = -1;
+	return getIndex (astar->bounds, 
+			 (coord_t) {c.x + dist * delta.x, c.y + dist * delta.y});
+}
 
-	insert (astar->open, astar->start, estimateDistance (startCoord, endCoord));
+// one table entry, given that the entries of the next cell in the same
+// direction (and for diagonals, the straight entries of that cell) are
+// already filled in
+static int jumpDistance (astar_t *astar, int *distances, coord_t c, direction dir)
+{
+	coord_t next = adjustInDirection (c, dir);
+	if (!isEnterable (astar, next))
+		return 0;
 
-	return 1;
-}
+	if (forcedNeighbours (astar, next, dir))
+		return 1;
 
+	int n = getIndex (astar->bounds, next);
+	if (directionIsDiagonal (dir) &&
+	    (distances[n * 8 + (dir + 7) % 8] > 0 || 
+	     distances[n * 8 + (dir + 1) % 8] > 0))
+		return 1;
 
-int *astar_compute (const char *grid, 
-		    int *solLength, 
-		    int boundX, 
-		    int boundY, 
-		    int start, 
-		    int end)
+	int nextDist = distances[n * 8 + dir];
+	return nextDist > 0 ? nextDist + 1 : nextDist - 1;
+}
+
+astar_jpsplus_t *astar_jpsplus_create (const char *grid, 
+				       int boundX, 
+				       int boundY)
 {
-	astar_t astar;
-	if (!init_astar_object (&astar, grid, solLength, boundX, boundY, start, end))
+#if ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL || ASTAR_LAYOUT != ASTAR_LAYOUT_ROW_MAJOR
+	return NULL;
+#endif
+	if (boundX <= 0 || boundY <= 0)
 		return NULL;
 
-	coord_t bounds = {boundX, boundY};
-	coord_t endCoord = getCoord (bounds, end);
-
-	while (astar.open->size) {
-		int node = findMin (astar.open)->value; 
-		coord_t nodeCoord = getCoord (bounds, node);
-		if (nodeCoord.x == endCoord.x && nodeCoord.y == endCoord.y) {
-			freeQueue (astar.open);
-			free (astar.closed);
-			free (astar.gScores);
+	astar_jpsplus_t *jpsplus = malloc (sizeof (astar_jpsplus_t));
+	if (!jpsplus)
+		return NULL;
 
-			int *rv = recordSolution (&astar);
+	int *distances = malloc ((size_t) boundX * boundY * 8 * sizeof (int));
+	if (!distances) {
+		free (jpsplus);
+		return NULL;
+	}
 
-			free (astar.cameFrom);
+	jpsplus->grid = grid;
+	jpsplus->bounds = (coord_t) {boundX, boundY};
+	jpsplus->distances = jpsplus->ownDistances = distances;
 
-			return rv;
+	astar_t astar;
+	astar.grid = grid;
+	astar.bitgrid = NULL;
+	astar.neighbours = NULL;
+	astar.bounds = jpsplus->bounds;
+
+	// straight directions first, since the diagonals depend on them;
+	// each direction sweeps against its own direction of travel so
+	// that the next cell is always done before the current one
+	static const direction order[8] = {0, 2, 4, 6, 1, 3, 5, 7};
+	for (int i = 0; i < 8; i++) {
+		direction dir = order[i];
+		coord_t delta = directionDelta (dir);
+		for (int row = 0; row < boundY; row++) {
+			int y = delta.y > 0 ? boundY - 1 - row : row;
+			for (int col = 0; col < boundX; col++) {
+				int x = delta.x > 0 ? boundX - 1 - col : col;
+				coord_t c = {x, y};
+				distances[getIndex (astar.bounds, c) * 8 + dir] =
+					jumpDistance (&astar, distances, c, dir);
+			}
 		}
+	}
 
-		deleteMin (astar.open);
-		astar.closed[node] = 1;
+	return jpsplus;
+}
 
-		direction from = directionWeCameFrom (&astar, 
-						      node,
-						      astar.cameFrom[node]);
+astar_jpsplus_t *astar_jpsplus_create_from_tables (const char *grid, 
+						   int boundX, 
+						   int boundY, 
+						   const int *tables)
+{
+#if ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL || ASTAR_LAYOUT != ASTAR_LAYOUT_ROW_MAJOR
+	return NULL;
+#endif
+	if (boundX <= 0 || boundY <= 0)
+		return NULL;
 
-		directionset dirs = 
-			forcedNeighbours (&astar, nodeCoord, from) 
-		      | naturalNeighbours (from);
+	astar_jpsplus_t *jpsplus = malloc (sizeof (astar_jpsplus_t));
+	if (!jpsplus)
+		return NULL;
 
-		for (int dir = nextDirectionInSet (&dirs); dir != NO_DIRECTION; dir = nextDirectionInSet (&dirs))
-		{
-			int newNode = jump (&astar, dir, node);
-			coord_t newCoord = getCoord (bounds, newNode);
+	jpsplus->grid = grid;
+	jpsplus->bounds = (coord_t) {boundX, boundY};
+	jpsplus->distances = tables;
+	jpsplus->ownDistances = NULL;
+	return jpsplus;
+}
 
-			// this'll also bail out if jump() returned -1
-			if (!contained (bounds, newCoord))
-				continue;
+const int *astar_jpsplus_tables (const astar_jpsplus_t *jpsplus)
+{
+	return jpsplus->distances;
+}
 
-			if (astar.closed[newNode])
-				continue;
-			
-			addToOpenSet (&astar, newNode, node);
+void astar_jpsplus_free (astar_jpsplus_t *jpsplus)
+{
+	if (!jpsplus)
+		return;
+
+	free (jpsplus->ownDistances);
+	free (jpsplus);
+}
+
+/* Block-based jumping over the bit grid. Rather than visiting one cell at
+   a time, a straight jump loads the 64 cells ahead of it at once from the
+   line it travels along and from the lines on either side, and works out
+   in a few word operations which of those cells would stop it: a wall on
+   the line itself, or a forced neighbour, which for a straight move is a
+   cell whose side neighbour is blocked while the next cell on that side is
+   free. The first such cell, if any, is found with ctz or clz. */
+
+// 64 bits of a line starting at bit position pos, which may run off
+// either end of the line; bits outside it read as 0
+static uint64_t lineBits (const uint64_t *line, int words, int pos)
+{
+	if (!line || pos <= -64)
+		return 0;
+
+	if (pos < 0)
+		return lineBits (line, words, 0) << -pos;
+
+	int w = pos / 64;
+	int offset = pos % 64;
+	if (w >= words)
+		return 0;
+
+	uint64_t bits = line[w] >> offset;
+	if (offset && w + 1 < words)
+		bits |= line[w + 1] << (64 - offset);
+	return bits;
+}
+
+// scan along a line from pos (exclusive) towards higher or lower positions
+// and return the position of the first jump point, or -1 if a wall comes
+// first. sideA and sideB are the neighbouring lines, or NULL at the map
+// edge, and goalPos is the position of the goal if it's on this line.
+static int scanLine (const uint64_t *line, 
+		     const uint64_t *sideA, 
+		     const uint64_t *sideB, 
+		     int words, 
+		     int pos, 
+		     int forwards, 
+		     int goalPos,
+		     astar_stats_t *stats)
+{
+	(void) stats;
+	for (;;) {
+		// bit k of the chunk is position base + k, so going forwards
+		// the nearest stop is the lowest set bit, and going backwards
+		// the highest
+		int base = forwards ? pos + 1 : pos - 64;
+		int ahead = forwards ? 1 : -1;
+		uint64_t open = lineBits (line, words, base);
+		uint64_t a = lineBits (sideA, words, base);
+		uint64_t aNext = lineBits (sideA, words, base + ahead);
+		uint64_t b = lineBits (sideB, words, base);
+		uint64_t bNext = lineBits (sideB, words, base + ahead);
+
+		uint64_t stop = ~open | (~a & aNext) | (~b & bNext);
+		if (goalPos >= base && goalPos < base + 64)
+			stop |= (uint64_t) 1 << (goalPos - base);
+
+		if (forwards) {
+			if (stop) {
+				int k = __builtin_ctzll (stop);
+				STAT (stats->cellsScanned += k + 1);
+				return (open >> k) & 1 ? base + k : -1;
+			}
+			STAT (stats->cellsScanned += 64);
+			pos += 64;
+		}
+		else {
+			if (stop) {
+				int k = 63 - __builtin_clzll (stop);
+				STAT (stats->cellsScanned += 64 - k);
+				return (open >> k) & 1 ? base + k : -1;
+			}
+			STAT (stats->cellsScanned += 64);
+			pos -= 64;
+		}
+	}
+}
+
+// a straight jump over the bit grid
+static int jumpBitsStraight (astar_t *astar, direction dir, coord_t c)
+{
+	const astar_bitgrid_t *bitgrid = astar->bitgrid;
+	coord_t bounds = astar->bounds;
+	coord_t goal = getCoord (bounds, astar->goal);
+	int forwards = dir == 2 || dir == 4;
+
+	if (dir == 2 || dir == 6) {
+		int words = bitgrid->rowWords;
+		const uint64_t *row = bitgrid->rows + c.y * words;
+		int x = scanLine (row,
+				  c.y > 0 ? row - words : NULL,
+				  c.y + 1 < bounds.y ? row + words : NULL,
+				  words, c.x, forwards,
+				  goal.y == c.y ? goal.x : -1, astar->stats);
+		return x < 0 ? -1 : getIndex (bounds, (coord_t) {x, c.y});
+	}
+	else {
+		int words = bitgrid->colWords;
+		const uint64_t *col = bitgrid->cols + c.x * words;
+		int y = scanLine (col,
+				  c.x > 0 ? col - words : NULL,
+				  c.x + 1 < bounds.x ? col + words : NULL,
+				  words, c.y, forwards,
+				  goal.x == c.x ? goal.y : -1, astar->stats);
+		return y < 0 ? -1 : getIndex (bounds, (coord_t) {c.x, y});
+	}
+}
+
+// jump() over the bit grid: straight jumps are done a word at a time,
+// diagonals still go cell by cell but probe with the straight scans
+static int jumpBits (astar_t *astar, direction dir, int start)
+{
+	coord_t coord = getCoord (astar->bounds, start);
+
+	if (!directionIsDiagonal (dir))
+		return jumpBitsStraight (astar, dir, coord);
+
+	for (;;) {
+		STAT (astar->stats->cellsScanned++);
+		coord = adjustInDirection (coord, dir);
+		if (!isEnterable (astar, coord))
+			return -1;
+
+		int node = getIndex (astar->bounds, coord);
+		if (node == astar->goal || 
+		    forcedNeighbours (astar, coord, dir) ||
+		    jumpBitsStraight (astar, (dir + 7) % 8, coord) >= 0 ||
+		    jumpBitsStraight (astar, (dir + 1) % 8, coord) >= 0)
+			return node;
+	}
+}
+
+astar_bitgrid_t *astar_bitgrid_create (const char *grid, 
+				       int boundX, 
+				       int boundY)
+{
+#if ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL || ASTAR_LAYOUT != ASTAR_LAYOUT_ROW_MAJOR
+	return NULL;
+#endif
+	if (boundX <= 0 || boundY <= 0)
+		return NULL;
+
+	astar_bitgrid_t *bitgrid = malloc (sizeof (astar_bitgrid_t));
+	if (!bitgrid)
+		return NULL;
+
+	bitgrid->bounds = (coord_t) {boundX, boundY};
+	bitgrid->rowWords = (boundX + 63) / 64;
+	bitgrid->colWords = (boundY + 63) / 64;
+	bitgrid->rows = calloc ((size_t) bitgrid->rowWords * boundY, sizeof (uint64_t));
+	bitgrid->cols = calloc ((size_t) bitgrid->colWords * boundX, sizeof (uint64_t));
+	if (!bitgrid->rows || !bitgrid->cols) {
+		astar_bitgrid_free (bitgrid);
+		return NULL;
+	}
+
+	for (int y = 0; y < boundY; y++)
+		for (int x = 0; x < boundX; x++)
+			if (grid[getIndex (bitgrid->bounds, (coord_t) {x, y})])
+				astar_bitgrid_set (bitgrid, x, y, 1);
+
+	return bitgrid;
+}
+
+void astar_bitgrid_set (astar_bitgrid_t *bitgrid, int x, int y, int enterable)
+{
+	uint64_t *rowWord = bitgrid->rows + y * bitgrid->rowWords + x / 64;
+	uint64_t *colWord = bitgrid->cols + x * bitgrid->colWords + y / 64;
+	uint64_t rowBit = (uint64_t) 1 << (x % 64);
+	uint64_t colBit = (uint64_t) 1 << (y % 64);
+
+	if (enterable) {
+		*rowWord |= rowBit;
+		*colWord |= colBit;
+	}
+	else {
+		*rowWord &= ~rowBit;
+		*colWord &= ~colBit;
+	}
+}
+
+void astar_bitgrid_free (astar_bitgrid_t *bitgrid)
+{
+	if (!bitgrid)
+		return;
+
+	free (bitgrid->rows);
+	free (bitgrid->cols);
+	free (bitgrid);
+}
+
+// Connected components of the grid under the same movement the searches
+// use. Without corner cutting, two cells a diagonal step apart are also
+// joined the straight way round, so there, as with 4-way movement, only
+// the straight neighbours count; CONNECTING_STEP skips the diagonals.
+#if ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL
+#define CONNECTING_STEP 1
+#else
+#define CONNECTING_STEP 2
+#endif
+
+// labels holds each cell's component, 0 for blocked cells, and sizes the
+// number of cells in each component. Components that have become empty
+// are chained into a free list through sizes, each holding minus the next
+// free label. queue and mark are scratch space for relabelling; a cell is
+// marked in the current round if its mark is at least round * 4.
+struct astar_components {
+	coord_t bounds;
+	int *labels;
+	int *sizes;
+	int nLabels;
+	int freeLabel;
+	int *queue;
+	unsigned int *mark;
+	unsigned int round;
+};
+
+// union-find root, halving the path on the way
+static int findRoot (int *parent, int l)
+{
+	while (parent[l] != l) {
+		parent[l] = parent[parent[l]];
+		l = parent[l];
+	}
+	return l;
+}
+
+static int newLabel (astar_components_t *components)
+{
+	int label = components->freeLabel;
+	if (label)
+		components->freeLabel = -components->sizes[label];
+	else
+		label = components->nLabels++;
+	components->sizes[label] = 0;
+	return label;
+}
+
+static void freeLabel (astar_components_t *components, int label)
+{
+	components->sizes[label] = -components->freeLabel;
+	components->freeLabel = label;
+}
+
+astar_components_t *astar_components_create (const char *grid, 
+					     int boundX, 
+					     int boundY)
+{
+	if (boundX <= 0 || boundY <= 0)
+		return NULL;
+
+	int size = layoutSize ((coord_t) {boundX, boundY});
+
+	astar_components_t *components = malloc (sizeof (astar_components_t));
+	if (!components)
+		return NULL;
+
+	coord_t bounds = {boundX, boundY};
+	components->bounds = bounds;
+	components->freeLabel = 0;
+	components->round = 0;
+	components->labels = calloc (size, sizeof (int));
+	components->sizes = malloc ((size + 1) * sizeof (int));
+	components->queue = malloc ((size + 1) * sizeof (int));
+	components->mark = calloc (size, sizeof (unsigned int));
+	if (!components->labels || !components->sizes || 
+	    !components->queue || !components->mark) {
+		astar_components_free (components);
+		return NULL;
+	}
+
+	int *labels = components->labels;
+
+	// first pass: provisional labels, with sizes serving as a union-find
+	// forest over them. Only the neighbours that come earlier in the scan
+	// have labels yet, and those are all we need to look at.
+	int *parent = components->sizes;
+	int next = 1;
+	static const direction earlier[4] = {6, 7, 0, 1};
+	for (int y = 0; y < boundY; y++) {
+		for (int x = 0; x < boundX; x++) {
+			coord_t c = {x, y};
+			int node = getIndex (bounds, c);
+			if (!grid[node])
+				continue;
+
+			int label = 0;
+			for (int i = 0; i < 4; i += CONNECTING_STEP) {
+				coord_t neighbour = adjustInDirection (c, earlier[i]);
+				if (!contained (bounds, neighbour) || 
+				    !labels[getIndex (bounds, neighbour)])
+					continue;
+
+				int root = findRoot (parent, labels[getIndex (bounds, neighbour)]);
+				if (!label)
+					label = root;
+				else if (root != label)
+					parent[root] = label;
+			}
+
+			if (!label) {
+				label = next++;
+				parent[label] = label;
+			}
+			labels[node] = label;
+		}
+	}
+
+	// second pass: number the components consecutively, and count them
+	int *compact = components->queue;
+	components->nLabels = 1;
+	for (int l = 1; l < next; l++)
+		compact[l] = 0;
+	for (int l = 1; l < next; l++) {
+		int root = findRoot (parent, l);
+		if (!compact[root])
+			compact[root] = components->nLabels++;
+	}
+
+	for (int i = 0; i < size; i++)
+		if (labels[i])
+			labels[i] = compact[findRoot (parent, labels[i])];
+
+	for (int l = 0; l < components->nLabels; l++)
+		components->sizes[l] = 0;
+	for (int i = 0; i < size; i++)
+		if (labels[i])
+			components->sizes[labels[i]]++;
+
+	return components;
+}
+
+// flood fill from node, moving its whole component over to label
+static void relabel (astar_components_t *components, int node, int label)
+{
+	coord_t bounds = components->bounds;
+	int *labels = components->labels;
+	int *queue = components->queue;
+	int old = labels[node];
+	int head = 0, tail = 0;
+
+	labels[node] = label;
+	queue[tail++] = node;
+	while (head < tail) {
+		coord_t c = getCoord (bounds, queue[head++]);
+		for (int dir = 0; dir < 8; dir += CONNECTING_STEP) {
+			coord_t neighbour = adjustInDirection (c, dir);
+			if (!contained (bounds, neighbour))
+				continue;
+
+			int n = getIndex (bounds, neighbour);
+			if (labels[n] == old) {
+				labels[n] = label;
+				queue[tail++] = n;
+			}
+		}
+	}
+
+	components->sizes[label] += tail;
+	freeLabel (components, old);
+}
+
+// A cell became enterable, so it joins the components around it into
+// one. The largest of them keeps its label and the others get relabelled.
+static void openCell (astar_components_t *components, coord_t c)
+{
+	coord_t bounds = components->bounds;
+	int *labels = components->labels;
+	int *sizes = components->sizes;
+
+	int largest = 0;
+	for (int dir = 0; dir < 8; dir += CONNECTING_STEP) {
+		coord_t neighbour = adjustInDirection (c, dir);
+		if (!contained (bounds, neighbour))
+			continue;
+
+		int l = labels[getIndex (bounds, neighbour)];
+		if (l && (!largest || sizes[l] > sizes[largest]))
+			largest = l;
+	}
+
+	if (!largest)
+		largest = newLabel (components);
+
+	for (int dir = 0; dir < 8; dir += CONNECTING_STEP) {
+		coord_t neighbour = adjustInDirection (c, dir);
+		if (!contained (bounds, neighbour))
+			continue;
+
+		int n = getIndex (bounds, neighbour);
+		if (labels[n] && labels[n] != largest)
+			relabel (components, n, largest);
+	}
+
+	labels[getIndex (bounds, c)] = largest;
+	sizes[largest]++;
+}
+
+static int groupRoot (const int *groupParent, int g)
+{
+	while (groupParent[g] != g)
+		g = groupParent[g];
+	return g;
+}
+
+// A cell got blocked, which may split its component. If its enterable
+// neighbours are connected to each other just through the ring of cells
+// around it, it didn't. Otherwise we flood from each separate group of
+// neighbours at once, breadth first, merging floods that meet. When all
+// but one of the floods have run out of cells, the ones that did have
+// found the pieces that split off, and only those get new labels, so this
+// costs about as much as the smaller pieces are big.
+static void blockCell (astar_components_t *components, coord_t c)
+{
+	coord_t bounds = components->bounds;
+	int *labels = components->labels;
+	int *sizes = components->sizes;
+	int node = getIndex (bounds, c);
+	int old = labels[node];
+
+	labels[node] = 0;
+	if (--sizes[old] == 0) {
+		freeLabel (components, old);
+		return;
+	}
+
+	// group the neighbours: cells next to each other around the ring are
+	// adjacent, and so are two straight neighbours a diagonal apart, such
+	// as north and east, if diagonals connect. Where they don't, the
+	// diagonal neighbours only count for joining up the straight ones, and
+	// a group of nothing but diagonals is flooded needlessly but harmlessly.
+	int ring[8];
+	int ringParent[8];
+	for (int dir = 0; dir < 8; dir++) {
+		coord_t neighbour = adjustInDirection (c, dir);
+		ring[dir] = contained (bounds, neighbour) && 
+			labels[getIndex (bounds, neighbour)] == old ? 
+			getIndex (bounds, neighbour) : -1;
+		ringParent[dir] = dir;
+	}
+	for (int dir = 0; dir < 8; dir++) {
+		if (ring[dir] < 0)
+			continue;
+		if (ring[(dir + 1) % 8] >= 0)
+			ringParent[findRoot (ringParent, (dir + 1) % 8)] = 
+				findRoot (ringParent, dir);
+		if (CONNECTING_STEP == 1 && 
+		    !directionIsDiagonal (dir) && ring[(dir + 2) % 8] >= 0)
+			ringParent[findRoot (ringParent, (dir + 2) % 8)] = 
+				findRoot (ringParent, dir);
+	}
+
+	// there are at most four groups, when only the diagonals are open
+	int seeds[4];
+	int nGroups = 0;
+	for (int dir = 0; dir < 8; dir++)
+		if (ring[dir] >= 0 && findRoot (ringParent, dir) == dir)
+			seeds[nGroups++] = ring[dir];
+
+	if (nGroups <= 1)
+		return;
+
+	if (++components->round > UINT_MAX / 4 - 1) {
+		memset (components->mark, 0, 
+			layoutSize (bounds) * sizeof (unsigned int));
+		components->round = 1;
+	}
+	unsigned int base = components->round * 4;
+	unsigned int *mark = components->mark;
+	int *queue = components->queue;
+
+	// pending: cells queued but not yet expanded, per flood
+	int groupParent[4];
+	int pending[4];
+	for (int g = 0; g < nGroups; g++) {
+		groupParent[g] = g;
+		pending[g] = 1;
+		mark[seeds[g]] = base + g;
+		queue[g] = seeds[g];
+	}
+
+	int head = 0, tail = nGroups;
+	int running = nGroups;
+	while (running > 1) {
+		int n = queue[head++];
+		int g = groupRoot (groupParent, mark[n] - base);
+		pending[g]--;
+
+		coord_t nc = getCoord (bounds, n);
+		for (int dir = 0; dir < 8; dir += CONNECTING_STEP) {
+			coord_t neighbour = adjustInDirection (nc, dir);
+			if (!contained (bounds, neighbour))
+				continue;
+
+			int m = getIndex (bounds, neighbour);
+			if (labels[m] != old)
+				continue;
+
+			if (mark[m] < base) {
+				mark[m] = base + g;
+				queue[tail++] = m;
+				pending[g]++;
+				continue;
+			}
+
+			// another flood got here first, so it's the same piece;
+			// it can't have finished already, or it would have
+			// reached n before us
+			int h = groupRoot (groupParent, mark[m] - base);
+			if (h != g) {
+				groupParent[h] = g;
+				pending[g] += pending[h];
+				running--;
+			}
+		}
+
+		if (!pending[g])
+			running--;
+	}
+
+	// whichever flood is still going keeps the old label; if they all
+	// finished at once, the first one does
+	int keeper = -1;
+	int newLabels[4];
+	for (int g = 0; g < nGroups; g++) {
+		if (groupParent[g] != g)
+			continue;
+		if (keeper < 0 || pending[g])
+			keeper = g;
+	}
+	for (int g = 0; g < nGroups; g++)
+		newLabels[g] = groupParent[g] == g && g != keeper ? 
+			newLabel (components) : 0;
+
+	for (int i = 0; i < tail; i++) {
+		int g = groupRoot (groupParent, mark[queue[i]] - base);
+		if (g == keeper)
+			continue;
+
+		labels[queue[i]] = newLabels[g];
+		sizes[newLabels[g]]++;
+		sizes[old]--;
+	}
+}
+
+void astar_components_set (astar_components_t *components, 
+			   int x, 
+			   int y, 
+			   int enterable)
+{
+	coord_t c = {x, y};
+	if (!contained (components->bounds, c))
+		return;
+
+	int labelled = components->labels[getIndex (components->bounds, c)] != 0;
+	if (enterable && !labelled)
+		openCell (components, c);
+	else if (!enterable && labelled)
+		blockCell (components, c);
+}
+
+int astar_components_connected (const astar_components_t *components, 
+				int start, 
+				int end)
+{
+	coord_t bounds = components->bounds;
+	const int *labels = components->labels;
+	int size = layoutSize (bounds);
+
+	if (start >= size || start < 0 || end >= size || end < 0)
+		return 0;
+
+	if (start == end)
+		return 1;
+
+	int goalLabel = labels[end];
+	if (!goalLabel)
+		return 0;
+
+	if (labels[start])
+		return labels[start] == goalLabel;
+
+	// the searches expand the start node even when it's blocked, so they
+	// get out if any of its neighbours is in the goal's component
+	coord_t startCoord = getCoord (bounds, start);
+	if (!contained (bounds, startCoord))
+		return 0;
+	for (int dir = 0; dir < 8; dir += CONNECTING_STEP) {
+		coord_t neighbour = adjustInDirection (startCoord, dir);
+		if (contained (bounds, neighbour) && 
+		    labels[getIndex (bounds, neighbour)] == goalLabel)
+			return 1;
+	}
+	return 0;
+}
+
+void astar_components_free (astar_components_t *components)
+{
+	if (!components)
+		return;
+
+	free (components->labels);
+	free (components->sizes);
+	free (components->queue);
+	free (components->mark);
+	free (components);
+}
+
+// Path interpolation between jump points in here. Going back from the
+// goal along cameFrom, each jump point is joined to the one it came from by
+// stepping diagonally while both coordinates differ, then straight.
+static int sign (int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+// the number of steps on the path, i.e. the solution length
+static int solutionSteps (astar_t *astar)
+{
+	int steps = 0;
+	for (int n = astar->goal; n != astar->start; n = astar->cameFrom[n]) {
+		coord_t c = getCoord (astar->bounds, n);
+		coord_t from = getCoord (astar->bounds, astar->cameFrom[n]);
+		int dx = abs (c.x - from.x);
+		int dy = abs (c.y - from.y);
+		steps += dx > dy ? dx : dy;
+	}
+	return steps;
+}
+
+// write the path, goal first, into rv, which must have room for
+// solutionSteps () + 1 nodes
+static void writeSolution (astar_t *astar, int *rv)
+{
+	int i = 0;
+	rv[i++] = astar->goal;
+	for (int n = astar->goal; n != astar->start; n = astar->cameFrom[n]) {
+		coord_t c = getCoord (astar->bounds, n);
+		coord_t target = getCoord (astar->bounds, astar->cameFrom[n]);
+		while (c.x != target.x || c.y != target.y) {
+			c.x += sign (target.x - c.x);
+			c.y += sign (target.y - c.y);
+			rv[i++] = getIndex (astar->bounds, c);
+		}
+	}
+}
+
+// The path is counted before it's written, so it's allocated once at
+// exactly the right size.
+static int *recordSolution (astar_t *astar)
+{
+	int steps = solutionSteps (astar);
+	int *rv = astar->alloc->malloc (astar->alloc->user, (steps + 1) * sizeof (int));
+	if (!rv) {
+		*astar->solutionLength = ASTAR_ERROR_NO_MEMORY;
+		return NULL;
+	}
+
+	writeSolution (astar, rv);
+	*astar->solutionLength = steps;
+	return rv;
+}
+
+// Is the path straight through this jump point? Jump searches stop in the
+// middle of straight lines, e.g. next to a forced neighbour that turned
+// out not to matter, and those make no waypoints.
+static int goesStraightThrough (astar_t *astar, int node, int towardsGoal)
+{
+	if (node == astar->goal || node == astar->start)
+		return 0;
+
+	coord_t c = getCoord (astar->bounds, node);
+	coord_t to = getCoord (astar->bounds, towardsGoal);
+	coord_t from = getCoord (astar->bounds, astar->cameFrom[node]);
+	return sign (to.x - c.x) == sign (c.x - from.x) && 
+		sign (to.y - c.y) == sign (c.y - from.y);
+}
+
+// The waypoints of the path in the order they're walked: the start, every
+// jump point where the path turns, and the goal. Returns how many there
+// are, but only writes them if there's room for them all.
+static int writeWaypoints (astar_t *astar, int *waypoints, int capacity)
+{
+	int count = 0;
+	int towardsGoal = -1;
+	for (int n = astar->goal; ; n = astar->cameFrom[n]) {
+		if (!goesStraightThrough (astar, n, towardsGoal))
+			count++;
+		if (n == astar->start)
+			break;
+		towardsGoal = n;
+	}
+
+	if (count > capacity)
+		return count;
+
+	int i = count;
+	towardsGoal = -1;
+	for (int n = astar->goal; ; n = astar->cameFrom[n]) {
+		if (!goesStraightThrough (astar, n, towardsGoal))
+			waypoints[--i] = n;
+		if (n == astar->start)
+			break;
+		towardsGoal = n;
+	}
+	return count;
+}
+
+static const queue_kind queueKinds[] = {
+	[ASTAR_OPEN_BINARY_HEAP] = QUEUE_BINARY_HEAP,
+	[ASTAR_OPEN_QUATERNARY_HEAP] = QUEUE_QUATERNARY_HEAP,
+	[ASTAR_OPEN_RADIX_HEAP] = QUEUE_RADIX_HEAP,
+	[ASTAR_OPEN_BUCKET_QUEUE] = QUEUE_BUCKET,
+};
+
+astar_context_t *astar_context_create (int boundX, int boundY)
+{
+	return astar_context_create_with_open_list (boundX, boundY, 
+						    ASTAR_OPEN_QUATERNARY_HEAP);
+}
+
+astar_context_t *astar_context_create_with_open_list (int boundX, 
+						      int boundY, 
+						      astar_open_list_t openList)
+{
+	return astar_context_create_with_allocator (boundX, boundY, openList, NULL);
+}
+
+astar_context_t *astar_context_create_with_allocator (int boundX, 
+						      int boundY, 
+						      astar_open_list_t openList,
+						      const astar_allocator_t *allocator)
+{
+	if (boundX <= 0 || boundY <= 0)
+		return NULL;
+
+	int size = layoutSize ((coord_t) {boundX, boundY});
+	if (!allocator)
+		allocator = &astar_default_allocator;
+
+	astar_context_t *ctx = allocator->malloc (allocator->user, sizeof (astar_context_t));
+	if (!ctx)
+		return NULL;
+
+	ctx->alloc = ctx->pathAlloc = *allocator;
+	ctx->bounds = (coord_t) {boundX, boundY};
+	ctx->generation = 0;
+	ctx->goalMarks = NULL;
+	ctx->components = NULL;
+	ctx->landmarks = NULL;
+	ctx->weight = 1;
+	ctx->arrivals = ctx->jumped = NULL;
+	memset (&ctx->stats, 0, sizeof (astar_stats_t));
+
+	if (openList < 0 || openList > ASTAR_OPEN_BUCKET_QUEUE)
+		openList = ASTAR_OPEN_QUATERNARY_HEAP;
+
+	// sized for the whole map up front, so the queue's index never
+	// needs to grow mid-search
+	ctx->open = createQueueWithAllocator (queueKinds[openList], size, allocator);
+	ctx->closed = allocator->malloc (allocator->user, size * sizeof (unsigned int));
+	ctx->gScores = allocator->malloc (allocator->user, size * sizeof (astar_cost_t));
+	ctx->cameFrom = allocator->malloc (allocator->user, size * sizeof (int));
+	ctx->arrival = allocator->malloc (allocator->user, size * sizeof (direction));
+	if (!ctx->open || !ctx->closed || !ctx->gScores || !ctx->cameFrom || !ctx->arrival) {
+		astar_context_free (ctx);
+		return NULL;
+	}
+
+	memset (ctx->closed, 0, size * sizeof (unsigned int));
+	return ctx;
+}
+
+void astar_context_set_path_allocator (astar_context_t *ctx, 
+				       const astar_allocator_t *allocator)
+{
+	ctx->pathAlloc = allocator ? *allocator : ctx->alloc;
+}
+
+void astar_context_free (astar_context_t *ctx)
+{
+	if (!ctx)
+		return;
+
+	astar_allocator_t alloc = ctx->alloc;
+	if (ctx->open)
+		freeQueue (ctx->open);
+	alloc.free (alloc.user, ctx->closed);
+	alloc.free (alloc.user, ctx->gScores);
+	alloc.free (alloc.user, ctx->cameFrom);
+	alloc.free (alloc.user, ctx->arrival);
+	alloc.free (alloc.user, ctx->goalMarks);
+	alloc.free (alloc.user, ctx->arrivals);
+	alloc.free (alloc.user, ctx->jumped);
+	alloc.free (alloc.user, ctx);
+}
+
+static int init_astar_object (astar_t* astar, astar_context_t *ctx, const char *grid, int *solLength, int start, int end)
+{
+	STAT (double setupStarted = now ());
+	memset (&ctx->stats, 0, sizeof (astar_stats_t));
+	*solLength = -1;
+	astar->solutionLength = solLength;
+	astar->outOfMemory = 0;
+	coord_t bounds = ctx->bounds;
+
+	int size = layoutSize (bounds);
+
+	if (start >= size || start < 0 || end >= size || end < 0)
+		return 0;
+
+	coord_t startCoord = getCoord (bounds, start);
+	coord_t endCoord = getCoord (bounds, end);
+
+	if (!contained (bounds, startCoord) || !contained (bounds, endCoord))
+		return 0;
+
+	// no path, no need to search
+	if (ctx->components && 
+	    !astar_components_connected (ctx->components, start, end))
+		return 0;
+
+	// once every 4 billion queries the stamps wrap around and we do have
+	// to clear them for real
+	if (++ctx->generation == 0) {
+		memset (ctx->closed, 0, size * sizeof (unsigned int));
+		if (ctx->goalMarks)
+			memset (ctx->goalMarks, 0, size * sizeof (unsigned int));
+		ctx->generation = 1;
+	}
+	clearQueue (ctx->open);
+
+	astar->bounds = bounds;
+	astar->start = start;
+	astar->goal = end;
+	astar->grid = grid;
+	astar->bitgrid = NULL;
+	astar->jpsplus = NULL;
+	astar->neighbours = NULL;
+	astar->landmarks = ctx->landmarks;
+	astar->jump = jump;
+	astar->open = ctx->open;
+	astar->closed = ctx->closed;
+	astar->generation = ctx->generation;
+	astar->gScores = ctx->gScores;
+	astar->cameFrom = ctx->cameFrom;
+	astar->arrival = ctx->arrival;
+	astar->goalCoord = endCoord;
+	astar->weight = ctx->weight;
+	astar->arrivals = ctx->weight > 1 ? ctx->arrivals : NULL;
+	astar->jumped = ctx->weight > 1 ? ctx->jumped : NULL;
+	astar->stats = &ctx->stats;
+	astar->alloc = &ctx->pathAlloc;
+	astar->other = NULL;
+	astar->meeting = NULL;
+	astar->goalMarks = NULL;
+
+	astar->gScores[start] = 0;
+	astar->cameFrom[start] = -1;
+	astar->arrival[start] = NO_DIRECTION;
+	if (astar->arrivals)
+		astar->arrivals[start] = astar->jumped[start] = 0;
+
+	if (insert (astar->open, astar->start, priorityEstimate (astar, start, startCoord))) {
+		astar->outOfMemory = 1;
+		*solLength = ASTAR_ERROR_NO_MEMORY;
+		return 0;
+	}
+	STAT (astar->stats->inserts = astar->stats->peakOpen = 1);
+
+	STAT (astar->stats->setupTime = now () - setupStarted);
+	return 1;
+}
+
+// once a search is over: if we got to the goal, build the path
+static int *finishSearch (astar_t *astar, int found)
+{
+	if (!found) {
+		if (astar->outOfMemory)
+			*astar->solutionLength = ASTAR_ERROR_NO_MEMORY;
+		return NULL;
+	}
+
+	STAT (double recordStarted = now ());
+	int *rv = recordSolution (astar);
+	STAT (astar->stats->recordTime = now () - recordStarted);
+	return rv;
+}
+
+
+// has the search going the other way reached this node?
+static int reachedByOther (astar_t *astar, int node)
+{
+	astar_t *other = astar->other;
+	return other->closed[node] == other->generation || exists (other->open, node);
+}
+
+// in a bidirectional search, see if the path through node is the best yet
+static void meet (astar_t *astar, int node)
+{
+	if (!reachedByOther (astar, node))
+		return;
+
+	astar_cost_t cost = astar->gScores[node] + astar->other->gScores[node];
+	if (astar->meeting->at < 0 || cost < astar->meeting->cost) {
+		astar->meeting->cost = cost;
+		astar->meeting->at = node;
+	}
+}
+
+/* With a weight above 1, nodes can be expanded before the cheapest way to
+   them is found, and jump point search only jumps on from a node in the
+   directions that the way it came leaves open. A node that's already been
+   expanded can then be reached in another way that leaves other
+   directions open, and skipping it, as the search does otherwise, can
+   lose paths altogether, not just make them longer. So every node keeps
+   the set of directions it's been reached from and the set it has jumped
+   in, and a closed node reached in a way that would have it jump in new
+   directions goes back on the open list to jump in those. Its gScore and
+   cameFrom only change if the new way is cheaper; paths through it that
+   were found before can only get cheaper by that. */
+static void reachWeighted (astar_t *astar,
+			   int node,
+			   int nodeFrom,
+			   coord_t nodeFromCoord,
+			   direction dir)
+{
+	if (astar->closed[node] != astar->generation) {
+		if (!exists (astar->open, node))
+			astar->arrivals[node] = astar->jumped[node] = 0;
+		astar->arrivals[node] |= 1 << dir;
+		addToOpenSet (astar, node, nodeFrom, nodeFromCoord, dir);
+		return;
+	}
+
+	astar->arrivals[node] |= 1 << dir;
+	coord_t nodeCoord = getCoord (astar->bounds, node);
+	directionset dirs = forcedNeighbours (astar, nodeCoord, dir) | naturalNeighbours (dir);
+	if (!(dirs & ~astar->jumped[node]))
+		return;
+
+	astar_cost_t gScore = astar->gScores[nodeFrom] + 
+		preciseDistance (nodeFromCoord, nodeCoord);
+	if (gScore < astar->gScores[node]) {
+		astar->gScores[node] = gScore;
+		astar->cameFrom[node] = nodeFrom;
+		astar->arrival[node] = dir;
+	}
+	double priority = astar->gScores[node] + priorityEstimate (astar, node, nodeCoord);
+	if (!exists (astar->open, node)) {
+		openInsert (astar, node, priority);
+		STAT (astar->stats->inserts++);
+	}
+	else if (priority < priorityOf (astar->open, node)) {
+		openChange (astar, node, priority);
+		STAT (astar->stats->changePriorities++);
+	}
+}
+
+// Expand a node just taken off the open list: jump in every direction
+// that the way we came to it leaves open, and add the jump points found.
+static void jpsExpandNode (astar_t *astar, int node)
+{
+	coord_t nodeCoord = getCoord (astar->bounds, node);
+	astar->closed[node] = astar->generation;
+	STAT (astar->stats->expanded++);
+
+	direction from = astar->arrival[node];
+	directionset dirs = 
+		forcedNeighbours (astar, nodeCoord, from) 
+	      | naturalNeighbours (from);
+	if (astar->arrivals) {
+		directionset arrivals = astar->arrivals[node];
+		for (int d = nextDirectionInSet (&arrivals); d != NO_DIRECTION; d = nextDirectionInSet (&arrivals))
+			dirs |= forcedNeighbours (astar, nodeCoord, d) | naturalNeighbours (d);
+		dirs &= ~astar->jumped[node];
+		astar->jumped[node] |= dirs;
+	}
+
+	for (int dir = nextDirectionInSet (&dirs); dir != NO_DIRECTION; dir = nextDirectionInSet (&dirs))
+	{
+		int newNode = astar->jump (astar, dir, node);
+		STAT (astar->stats->jumpCalls++);
+		if (newNode < 0)
+			continue;
+
+		if (astar->arrivals)
+			reachWeighted (astar, newNode, node, nodeCoord, dir);
+		else if (astar->closed[newNode] == astar->generation)
+			continue;
+		else
+			addToOpenSet (astar, newNode, node, nodeCoord, dir);
+		if (astar->other)
+			meet (astar, newNode);
+	}
+}
+
+// The main loop of jump point search; the caller picks the jump function.
+// Expands at most maxExpansions nodes, or as many as it takes if that's
+// negative, and returns whether it's done.
+static astar_status_t jpsExpand (astar_t *astar, int maxExpansions)
+{
+	STAT (double searchStarted = now ());
+	astar_status_t status = ASTAR_NOT_FOUND;
+
+	while (astar->open->size && !astar->outOfMemory) {
+		int node = findMin (astar->open)->value; 
+		if (node == astar->goal) {
+			status = ASTAR_FOUND;
+			break;
+		}
+
+		if (maxExpansions-- == 0) {
+			status = ASTAR_IN_PROGRESS;
+			break;
+		}
+
+		deleteMin (astar->open);
+		STAT (astar->stats->deleteMins++);
+		jpsExpandNode (astar, node);
+	}
+	if (astar->outOfMemory)
+		status = ASTAR_OUT_OF_MEMORY;
+
+	STAT (astar->stats->searchTime += now () - searchStarted);
+	return status;
+}
+
+static int *jpsSearch (astar_t *astar)
+{
+	return finishSearch (astar, jpsExpand (astar, -1) == ASTAR_FOUND);
+}
+
+int *astar_context_compute (astar_context_t *ctx,
+			    const char *grid, 
+			    int *solLength, 
+			    int start, 
+			    int end)
+{
+	astar_t astar;
+	if (!init_astar_object (&astar, ctx, grid, solLength, start, end))
+		return NULL;
+
+	return jpsSearch (&astar);
+}
+
+// a jump point search whose result goes into a buffer of the caller's,
+// either the whole path or only the waypoints
+static int computeInto (astar_context_t *ctx,
+			const char *grid, 
+			int start, 
+			int end, 
+			int *out, 
+			int capacity, 
+			int waypoints)
+{
+	astar_t astar;
+	int solLength;
+	if (!init_astar_object (&astar, ctx, grid, &solLength, start, end))
+		return solLength;
+	astar_status_t status = jpsExpand (&astar, -1);
+	if (status != ASTAR_FOUND)
+		return status == ASTAR_OUT_OF_MEMORY ? ASTAR_ERROR_NO_MEMORY : -1;
+
+	STAT (double recordStarted = now ());
+	int count;
+	if (waypoints)
+		count = writeWaypoints (&astar, out, capacity);
+	else {
+		count = solutionSteps (&astar) + 1;
+		if (count <= capacity)
+			writeSolution (&astar, out);
+	}
+	STAT (astar.stats->recordTime = now () - recordStarted);
+	return count;
+}
+
+int astar_context_compute_into (astar_context_t *ctx,
+				const char *grid, 
+				int start, 
+				int end, 
+				int *path, 
+				int capacity)
+{
+	return computeInto (ctx, grid, start, end, path, capacity, 0);
+}
+
+int astar_context_compute_waypoints (astar_context_t *ctx,
+				     const char *grid, 
+				     int start, 
+				     int end, 
+				     int *waypoints, 
+				     int capacity)
+{
+	return computeInto (ctx, grid, start, end, waypoints, capacity, 1);
+}
+
+// the per-node direction sets weighted searches need
+static int allocWeighted (astar_context_t *ctx)
+{
+	int size = layoutSize (ctx->bounds);
+	if (!ctx->arrivals)
+		ctx->arrivals = ctx->alloc.malloc (ctx->alloc.user, size * sizeof (directionset));
+	if (!ctx->jumped)
+		ctx->jumped = ctx->alloc.malloc (ctx->alloc.user, size * sizeof (directionset));
+	return ctx->arrivals && ctx->jumped;
+}
+
+int astar_context_set_weight (astar_context_t *ctx, double weight)
+{
+	// NaN fails this too
+	if (!(weight >= 1) || (weight > 1 && !allocWeighted (ctx)))
+		return 0;
+
+	ctx->weight = weight;
+	return 1;
+}
+
+/* Restarting weighted A*: every improving search starts from scratch with
+   a smaller weight. ARA* would keep the previous search's nodes instead,
+   but which directions jump point search expands a node in depends on the
+   way it was reached, so the old search tree can't simply be reused. The
+   weights close half of the gap to 1 each time, and go to 1 once they're
+   within 1% of it. */
+int *astar_context_compute_anytime (astar_context_t *ctx,
+				    const char *grid, 
+				    int *solLength, 
+				    int start, 
+				    int end, 
+				    double weight, 
+				    int maxExpansions, 
+				    double *bound)
+{
+	*solLength = -1;
+	if (!(weight >= 1) || (weight > 1 && !allocWeighted (ctx)))
+		return NULL;
+
+	double ownWeight = ctx->weight;
+	int *best = NULL;
+	astar_cost_t bestCost = 0;
+	for (;;) {
+		astar_t astar;
+		int length;
+		ctx->weight = weight;
+		if (!init_astar_object (&astar, ctx, grid, &length, start, end)) {
+			if (!best)
+				*solLength = length;
+			break;
+		}
+
+		astar_status_t status;
+		if (!best)
+			status = jpsExpand (&astar, -1);
+		else {
+			// a node at a time, to keep count of the budget
+			while ((status = jpsExpand (&astar, 1)) == ASTAR_IN_PROGRESS &&
+			       (maxExpansions < 0 || --maxExpansions > 0))
+				;
+		}
+		// running out of memory after a path has been found still
+		// leaves that path
+		if (status != ASTAR_FOUND) {
+			if (!best && status == ASTAR_OUT_OF_MEMORY)
+				*solLength = ASTAR_ERROR_NO_MEMORY;
+			break;
+		}
+
+		astar_cost_t cost = astar.gScores[end];
+		if (!best || cost < bestCost) {
+			int *path = finishSearch (&astar, 1);
+			if (!path) {
+				if (!best)
+					*solLength = length;
+				break;
+			}
+			ctx->pathAlloc.free (ctx->pathAlloc.user, best);
+			best = path;
+			bestCost = cost;
+			*solLength = length;
+		}
+		*bound = weight;
+
+		if (weight == 1 || maxExpansions == 0)
+			break;
+		weight = weight - 1 < 0.02 ? 1 : 1 + (weight - 1) / 2;
+	}
+
+	ctx->weight = ownWeight;
+	return best;
+}
+
+// Turn the backward half's path from the meeting point to the goal around
+// and hang it onto the forward half's, so that recordSolution can follow
+// cameFrom all the way from the goal to the start.
+static void spliceSolution (astar_t *forward, astar_t *backward, int at)
+{
+	int prev = at;
+	for (int n = backward->cameFrom[at]; n != -1; n = backward->cameFrom[n]) {
+		forward->cameFrom[n] = prev;
+		prev = n;
+	}
+}
+
+/* Both halves are jump point searches of their own, the backward one from
+   the goal to the start; moves are symmetric, so its paths are paths from
+   the start turned around. They take turns, the one with the smaller open
+   list expanding a node, and whenever one reaches a node the other has
+   reached too, that makes a path. Once the cheapest such path costs no
+   more than the lowest priority in either open list, no path left to find
+   can be cheaper with a consistent estimate. If either half runs out of
+   nodes, there's no path other than the ones already found. */
+static int *bidirSearch (astar_t *forward, astar_t *backward, meeting *m)
+{
+	m->at = -1;
+	forward->other = backward;
+	backward->other = forward;
+	forward->meeting = backward->meeting = m;
+
+	while (forward->open->size && backward->open->size) {
+		if (m->at >= 0 &&
+		    (findMin (forward->open)->priority >= m->cost ||
+		     findMin (backward->open)->priority >= m->cost))
+			break;
+
+		// a half that gets to the top of its open list to its own goal
+		// is done too, and that path is already in m
+		astar_t *half = forward->open->size <= backward->open->size ? 
+			forward : backward;
+		if (jpsExpand (half, 1) != ASTAR_IN_PROGRESS)
+			break;
+	}
+
+	if (forward->outOfMemory || backward->outOfMemory) {
+		*forward->solutionLength = ASTAR_ERROR_NO_MEMORY;
+		return NULL;
+	}
+	if (m->at < 0)
+		return NULL;
+
+	spliceSolution (forward, backward, m->at);
+	return finishSearch (forward, 1);
+}
+
+int *astar_context_compute_bidir (astar_context_t *forwardCtx,
+				  astar_context_t *backwardCtx,
+				  const char *grid, 
+				  int *solLength, 
+				  int start, 
+				  int end)
+{
+	astar_t forward, backward;
+	meeting m;
+	int backwardLength;
+	if (forwardCtx == backwardCtx ||
+	    forwardCtx->bounds.x != backwardCtx->bounds.x || 
+	    forwardCtx->bounds.y != backwardCtx->bounds.y) {
+		*solLength = -1;
+		return NULL;
+	}
+
+	if (!init_astar_object (&forward, forwardCtx, grid, solLength, start, end))
+		return NULL;
+
+	// a blocked start can be left but not entered, and a blocked goal
+	// entered but not left, which the backward half would get the wrong
+	// way around; those, and trivial queries, go one way only
+	if (start == end || !grid[start] || !grid[end])
+		return jpsSearch (&forward);
+
+	if (!init_astar_object (&backward, backwardCtx, grid, &backwardLength, end, start)) {
+		*solLength = backwardLength;
+		return NULL;
+	}
 
-		}
+	return bidirSearch (&forward, &backward, &m);
+}
+
+int *astar_context_compute_jpsplus (astar_context_t *ctx,
+				    const astar_jpsplus_t *jpsplus,
+				    int *solLength, 
+				    int start, 
+				    int end)
+{
+	astar_t astar;
+	if (jpsplus->bounds.x != ctx->bounds.x || 
+	    jpsplus->bounds.y != ctx->bounds.y) {
+		*solLength = -1;
+		return NULL;
 	}
-	freeQueue (astar.open);
-	free (astar.closed);
-	free (astar.gScores);
-	free (astar.cameFrom);
 
-	return NULL;
+	if (!init_astar_object (&astar, ctx, jpsplus->grid, solLength, start, end))
+		return NULL;
+
+	astar.jpsplus = jpsplus;
+	astar.jump = jumpPlus;
+	return jpsSearch (&astar);
 }
 
+int *astar_context_compute_bitgrid (astar_context_t *ctx,
+				    const astar_bitgrid_t *bitgrid,
+				    int *solLength, 
+				    int start, 
+				    int end)
+{
+	astar_t astar;
+	if (bitgrid->bounds.x != ctx->bounds.x || 
+	    bitgrid->bounds.y != ctx->bounds.y) {
+		*solLength = -1;
+		return NULL;
+	}
 
+	if (!init_astar_object (&astar, ctx, NULL, solLength, start, end))
+		return NULL;
 
-int *astar_unopt_compute (const char *grid, 
-		    int *solLength, 
-		    int boundX, 
-		    int boundY, 
-		    int start, 
-		    int end)
+	astar.bitgrid = bitgrid;
+	astar.jump = jumpBits;
+	return jpsSearch (&astar);
+}
+
+int *astar_context_compute_neighbours (astar_context_t *ctx,
+				       const astar_neighbours_t *neighbours,
+				       int *solLength, 
+				       int start, 
+				       int end)
 {
 	astar_t astar;
+	if (neighbours->bounds.x != ctx->bounds.x || 
+	    neighbours->bounds.y != ctx->bounds.y) {
+		*solLength = -1;
+		return NULL;
+	}
 
-	if (!init_astar_object (&astar, grid, solLength, boundX, boundY, start, end))
+	if (!init_astar_object (&astar, ctx, NULL, solLength, start, end))
 		return NULL;
 
-	coord_t bounds = {boundX, boundY};
-	coord_t endCoord = getCoord (bounds, end);
+	astar.neighbours = neighbours;
+	astar.jump = jumpMasks;
+	return jpsSearch (&astar);
+}
 
-	while (astar.open->size) {
-		int node = findMin (astar.open)->value; 
+// plain A*, looking at all 8 neighbours of every node
+static int *unoptSearch (astar_t *astar)
+{
+	coord_t bounds = astar->bounds;
+	coord_t endCoord = getCoord (bounds, astar->goal);
+	STAT (double searchStarted = now ());
+	int found = 0;
+
+	while (astar->open->size && !astar->outOfMemory) {
+		int node = findMin (astar->open)->value; 
 		coord_t nodeCoord = getCoord (bounds, node);
 		if (nodeCoord.x == endCoord.x && nodeCoord.y == endCoord.y) {
-			freeQueue (astar.open);
-			free (astar.closed);
-			free (astar.gScores);
+			found = 1;
+			break;
+		}
+
+		deleteMin (astar->open);
+		astar->closed[node] = astar->generation;
+		STAT (astar->stats->deleteMins++);
+		STAT (astar->stats->expanded++);
+
+		for (int dir = 0; dir < 8; dir++)
+		{
+			if (!canStep (astar, nodeCoord, dir))
+				continue;
+
+			coord_t newCoord = adjustInDirection (nodeCoord, dir);
+			int newNode = getIndex (bounds, newCoord);
+
+			if (astar->closed[newNode] == astar->generation)
+				continue;
+			
+			addToOpenSet (astar, newNode, node, nodeCoord, dir);
+		}
+	}
+
+	STAT (astar->stats->searchTime = now () - searchStarted);
+	return finishSearch (astar, found);
+}
+
+int *astar_context_unopt_compute (astar_context_t *ctx,
+				  const char *grid, 
+				  int *solLength, 
+				  int start, 
+				  int end)
+{
+	astar_t astar;
 
-			int *rv = recordSolution (&astar);
+	if (!init_astar_object (&astar, ctx, grid, solLength, start, end))
+		return NULL;
 
-			free (astar.cameFrom);
+	return unoptSearch (&astar);
+}
 
-			return rv;
+// Dijkstra's algorithm with jump point search, from the start until k of
+// the goals have been taken off the open list. Every goal has the shortest
+// path to it then, since the jumps stop at all of them.
+static int multiSearch (astar_t *astar, 
+			const int *goals, 
+			int nGoals, 
+			int k, 
+			int **paths, 
+			int *lengths)
+{
+	STAT (double searchStarted = now ());
+	int reached = 0;
+
+	while (astar->open->size && reached < k && !astar->outOfMemory) {
+		int node = findMin (astar->open)->value; 
+		deleteMin (astar->open);
+		STAT (astar->stats->deleteMins++);
+		if (astar->closed[node] == astar->generation)
+			continue;
+
+		if (astar->goalMarks[node] == astar->generation) {
+			// the same goal may be in the list more than once
+			STAT (double recordStarted = now ());
+			astar->goal = node;
+			for (int i = 0; i < nGoals; i++) {
+				if (goals[i] != node || paths[i])
+					continue;
+				// a path there isn't the memory for doesn't count
+				astar->solutionLength = &lengths[i];
+				paths[i] = recordSolution (astar);
+				if (paths[i])
+					reached++;
+			}
+			astar->goal = -1;
+			STAT (astar->stats->recordTime += now () - recordStarted);
+			if (reached >= k)
+				break;
 		}
 
+		jpsExpandNode (astar, node);
+	}
+
+	// the goals it didn't get to may well have paths
+	if (astar->outOfMemory)
+		for (int i = 0; i < nGoals; i++)
+			if (!paths[i])
+				lengths[i] = ASTAR_ERROR_NO_MEMORY;
+
+	STAT (astar->stats->searchTime = now () - searchStarted 
+	      - astar->stats->recordTime);
+	return reached;
+}
+
+int astar_context_compute_multi (astar_context_t *ctx,
+				 const char *grid, 
+				 int start, 
+				 const int *goals, 
+				 int nGoals, 
+				 int k, 
+				 int **paths, 
+				 int *lengths)
+{
+	int size = layoutSize (ctx->bounds);
+	int solLength;
+	for (int i = 0; i < nGoals; i++) {
+		paths[i] = NULL;
+		lengths[i] = -1;
+	}
+
+	if (!ctx->goalMarks) {
+		ctx->goalMarks = ctx->alloc.malloc (ctx->alloc.user, size * sizeof (unsigned int));
+		if (!ctx->goalMarks)
+			return 0;
+		memset (ctx->goalMarks, 0, size * sizeof (unsigned int));
+	}
+
+	astar_t astar;
+	if (!init_astar_object (&astar, ctx, grid, &solLength, start, start)) {
+		for (int i = 0; i < nGoals; i++)
+			lengths[i] = solLength;
+		return 0;
+	}
+
+	// the goals that can be reached at all, if the components can tell;
+	// once those are all found there's no point in searching further
+	int reachable = 0;
+	for (int i = 0; i < nGoals; i++) {
+		if (goals[i] < 0 || goals[i] >= size)
+			continue;
+		if (ctx->components && 
+		    !astar_components_connected (ctx->components, start, goals[i]))
+			continue;
+		ctx->goalMarks[goals[i]] = ctx->generation;
+		reachable++;
+	}
+	if (k <= 0 || k > reachable)
+		k = reachable;
+	if (k == 0)
+		return 0;
+
+	// the k nearest goals need the shortest paths, whatever the weight
+	// of the context, and with no goal there's nothing for it to weigh
+	astar.weight = 1;
+	astar.arrivals = astar.jumped = NULL;
+	astar.goal = -1;
+	astar.goalMarks = ctx->goalMarks;
+	astar.jump = jumpMulti;
+	return multiSearch (&astar, goals, nGoals, k, paths, lengths);
+}
+
+/* The distance field is Dijkstra's algorithm over every cell, outwards from
+   the goal. Jump point search doesn't help here, since every cell needs a
+   distance anyway. Moves between enterable cells cost the same both ways,
+   so the distances outwards from the goal are the distances to it. */
+int astar_context_distance_field (astar_context_t *ctx,
+				  const char *grid, 
+				  int goal, 
+				  astar_cost_t *costs, 
+				  unsigned char *next)
+{
+	astar_t astar;
+	int solLength;
+	coord_t bounds = ctx->bounds;
+	int size = layoutSize (bounds);
+	if (!init_astar_object (&astar, ctx, grid, &solLength, goal, goal))
+		return solLength;
+	// plain Dijkstra, whatever the weight of the context
+	astar.weight = 1;
+	astar.arrivals = astar.jumped = NULL;
+
+	STAT (double searchStarted = now ());
+	for (int i = 0; i < size; i++) {
+		costs[i] = -1;
+		if (next)
+			next[i] = ASTAR_NO_DIRECTION;
+	}
+	costs[goal] = 0;
+
+	// a blocked goal can't be entered, so nothing but the goal itself
+	// has a path to it
+	if (!grid[goal])
+		return 0;
+
+	while (astar.open->size) {
+		int node = findMin (astar.open)->value; 
 		deleteMin (astar.open);
-		astar.closed[node] = 1;
+		astar.closed[node] = astar.generation;
+		STAT (astar.stats->deleteMins++);
+		STAT (astar.stats->expanded++);
+		coord_t nodeCoord = getCoord (bounds, node);
 
-		for (int dir = 0; dir < 8; dir++)
-		{
+		for (int dir = 0; dir < 8; dir++) {
+			if (!canStep (&astar, nodeCoord, dir))
+				continue;
 			coord_t newCoord = adjustInDirection (nodeCoord, dir);
 			int newNode = getIndex (bounds, newCoord);
+			if (astar.closed[newNode] == astar.generation)
+				continue;
 
-			if (!contained (bounds, newCoord) || !grid[newNode])
+			astar_cost_t cost = costs[node] + 
+				preciseDistance (nodeCoord, newCoord);
+			if (costs[newNode] >= 0 && costs[newNode] <= cost)
 				continue;
 
-			if (astar.closed[newNode])
+			if (costs[newNode] < 0) {
+				if (insert (astar.open, newNode, cost))
+					return ASTAR_ERROR_NO_MEMORY;
+				STAT (astar.stats->inserts++);
+			}
+			else {
+				if (changePriority (astar.open, newNode, cost))
+					return ASTAR_ERROR_NO_MEMORY;
+				STAT (astar.stats->changePriorities++);
+			}
+			costs[newNode] = cost;
+			if (next)
+				next[newNode] = (dir + 4) % 8;
+		}
+	}
+
+	// blocked cells can't be entered, but searches starting on one can
+	// still leave it, so give them a way out too
+	for (int i = 0; i < size; i++) {
+		if (grid[i])
+			continue;
+		// nor the padding round a tiled grid
+		coord_t c = getCoord (bounds, i);
+		if (!contained (bounds, c))
+			continue;
+		for (int dir = 0; dir < 8; dir++) {
+			if (!canStep (&astar, c, dir))
 				continue;
-			
-			addToOpenSet (&astar, newNode, node);
+			coord_t nc = adjustInDirection (c, dir);
+			int n = getIndex (bounds, nc);
+			if (costs[n] < 0)
+				continue;
+			astar_cost_t cost = costs[n] + preciseDistance (c, nc);
+			if (costs[i] < 0 || cost < costs[i]) {
+				costs[i] = cost;
+				if (next)
+					next[i] = dir;
+			}
+		}
+	}
+
+	STAT (astar.stats->searchTime = now () - searchStarted);
+	return 0;
+}
+
+int astar_context_set_components (astar_context_t *ctx, 
+				  const astar_components_t *components)
+{
+	if (components && 
+	    (components->bounds.x != ctx->bounds.x || 
+	     components->bounds.y != ctx->bounds.y))
+		return 0;
+
+	ctx->components = components;
+	return 1;
+}
+
+#ifdef ASTAR_INTEGER_COSTS
+#define LANDMARK_STRAIGHT_COST ASTAR_COST_STRAIGHT
+#else
+#define LANDMARK_STRAIGHT_COST 1.0
+#endif
+
+static size_t landmarkTablesSize (int size, int count, int quantized)
+{
+	return sizeof (landmarkHeader) + count * sizeof (double) + 
+		(size_t) size * count * (quantized ? sizeof (uint16_t) : sizeof (astar_cost_t));
+}
+
+// point the landmarks into their block, and work out what a step of each
+// quantized table is worth; the block's header must already be checked
+static astar_landmarks_t *wrapLandmarkTables (const void *block, size_t size)
+{
+	const landmarkHeader *header = block;
+	const double *scales = (const double *) (header + 1);
+	const void *data = scales + header->count;
+
+	astar_landmarks_t *landmarks = calloc (1, sizeof (astar_landmarks_t));
+	if (!landmarks)
+		return NULL;
+
+	landmarks->bounds = (coord_t) {header->boundX, header->boundY};
+	landmarks->count = header->count;
+	landmarks->quantized = header->quantized;
+	landmarks->block = block;
+	landmarks->size = size;
+	if (!header->quantized) {
+		landmarks->costs = data;
+		return landmarks;
+	}
+
+	landmarks->steps = data;
+	landmarks->stepEstimates = malloc (header->count * sizeof (double));
+	if (!landmarks->stepEstimates) {
+		free (landmarks);
+		return NULL;
+	}
+	for (int i = 0; i < landmarks->count; i++)
+		landmarks->stepEstimates[i] = scales[i] * LANDMARK_STRAIGHT_COST / 
+			(LANDMARK_STRAIGHT_COST + scales[i]);
+	return landmarks;
+}
+
+/* The first landmark is the cell farthest from an arbitrary one, and each
+   of the others the cell farthest from its nearest landmark so far. Cells
+   no landmark reaches yet count as farthest of all, so that the parts of
+   a map split in pieces get landmarks too, but only while there are
+   enough of them for their share of the landmarks; otherwise a map with
+   lots of little sealed-off pockets would spend all its landmarks on
+   them.
+
+   costs gets count distances per cell, scales the quantization scale of
+   each landmark; field and nearest are scratch space. */
+static int measureLandmarks (astar_context_t *ctx, 
+			     const char *grid, 
+			     int landmark, 
+			     int count, 
+			     astar_cost_t *costs, 
+			     double *scales, 
+			     astar_cost_t *field, 
+			     astar_cost_t *nearest)
+{
+	int size = layoutSize (ctx->bounds);
+	if (astar_context_distance_field (ctx, grid, landmark, field, NULL))
+		return -1;
+	long enterable = 0;
+	for (int i = 0; i < size; i++) {
+		if (grid[i] && field[i] > field[landmark])
+			landmark = i;
+		if (grid[i])
+			enterable++;
+		nearest[i] = -1;
+	}
+
+	for (int k = 0; k < count; k++) {
+		if (astar_context_distance_field (ctx, grid, landmark, field, NULL))
+			return -1;
+
+		astar_cost_t longest = 0;
+		long unreached = 0;
+		for (int i = 0; i < size; i++) {
+			costs[(size_t) i * count + k] = field[i];
+			if (field[i] > longest)
+				longest = field[i];
+			if (field[i] >= 0 && (nearest[i] < 0 || field[i] < nearest[i]))
+				nearest[i] = field[i];
+			if (grid[i] && nearest[i] < 0)
+				unreached++;
+		}
+		scales[k] = longest > 0 ? longest / 65534.0 : 1;
 
+		int pickUnreached = unreached * count >= enterable;
+		for (int i = 0; i < size; i++) {
+			if (!grid[i])
+				continue;
+			if (nearest[i] < 0) {
+				if (!pickUnreached)
+					continue;
+				landmark = i;
+				break;
+			}
+			if (nearest[i] > nearest[landmark])
+				landmark = i;
 		}
 	}
-	freeQueue (astar.open);
-	free (astar.closed);
-	free (astar.gScores);
-	free (astar.cameFrom);
-	return NULL;
+	return 0;
+}
+
+astar_landmarks_t *astar_landmarks_create (const char *grid, 
+					   int boundX, 
+					   int boundY, 
+					   int count, 
+					   int quantized)
+{
+	if (boundX <= 0 || boundY <= 0 || count <= 0)
+		return NULL;
+
+	int size = layoutSize ((coord_t) {boundX, boundY});
+	int first = 0;
+	while (first < size && !grid[first])
+		first++;
+	if (first == size)
+		return NULL;
+
+	astar_context_t *ctx = astar_context_create (boundX, boundY);
+	astar_cost_t *field = malloc (size * sizeof (astar_cost_t));
+	astar_cost_t *nearest = malloc (size * sizeof (astar_cost_t));
+	astar_cost_t *costs = malloc ((size_t) size * count * sizeof (astar_cost_t));
+	size_t tablesSize = landmarkTablesSize (size, count, quantized);
+	landmarkHeader *header = calloc (1, tablesSize);
+	double *scales = header ? (double *) (header + 1) : NULL;
+	astar_landmarks_t *landmarks = NULL;
+	if (ctx && field && nearest && costs && header && 
+	    !measureLandmarks (ctx, grid, first, count, costs, scales, field, nearest)) {
+		header->count = count;
+		header->quantized = !!quantized;
+		header->costSize = sizeof (astar_cost_t);
+		header->layout = ASTAR_LAYOUT;
+		header->boundX = boundX;
+		header->boundY = boundY;
+		if (quantized) {
+			uint16_t *steps = (uint16_t *) (scales + count);
+			for (size_t i = 0; i < (size_t) size * count; i++) {
+				if (costs[i] < 0) {
+					steps[i] = UINT16_MAX;
+					continue;
+				}
+				double step = floor (costs[i] / scales[i % count]);
+				steps[i] = step < 65534 ? step : 65534;
+			}
+		}
+		else
+			memcpy (scales + count, costs, 
+				(size_t) size * count * sizeof (astar_cost_t));
+		landmarks = wrapLandmarkTables (header, tablesSize);
+	}
+
+	if (landmarks)
+		landmarks->ownBlock = header;
+	else
+		free (header);
+	astar_context_free (ctx);
+	free (field);
+	free (nearest);
+	free (costs);
+	return landmarks;
+}
+
+void astar_landmarks_free (astar_landmarks_t *landmarks)
+{
+	if (!landmarks)
+		return;
+
+	free (landmarks->stepEstimates);
+	free (landmarks->ownBlock);
+	free (landmarks);
+}
+
+const void *astar_landmarks_tables (const astar_landmarks_t *landmarks, size_t *size)
+{
+	*size = landmarks->size;
+	return landmarks->block;
+}
+
+astar_landmarks_t *astar_landmarks_create_from_tables (int boundX, 
+						       int boundY, 
+						       const void *tables, 
+						       size_t size)
+{
+	const landmarkHeader *header = tables;
+	if (boundX <= 0 || boundY <= 0 || !tables || size < sizeof (landmarkHeader))
+		return NULL;
+	if (header->count == 0 || header->count > INT_MAX / 2 || header->quantized > 1 || 
+	    header->costSize != sizeof (astar_cost_t) || header->layout != ASTAR_LAYOUT || 
+	    header->boundX != boundX || header->boundY != boundY)
+		return NULL;
+	int cells = layoutSize ((coord_t) {boundX, boundY});
+	if (size != landmarkTablesSize (cells, header->count, header->quantized))
+		return NULL;
+
+	return wrapLandmarkTables (tables, size);
+}
+
+int astar_context_set_landmarks (astar_context_t *ctx, 
+				 const astar_landmarks_t *landmarks)
+{
+	if (landmarks && 
+	    (landmarks->bounds.x != ctx->bounds.x || 
+	     landmarks->bounds.y != ctx->bounds.y))
+		return 0;
+
+	ctx->landmarks = landmarks;
+	return 1;
+}
+
+astar_search_t *astar_context_begin (astar_context_t *ctx,
+				     const char *grid, 
+				     int start, 
+				     int end)
+{
+	astar_search_t *search = ctx->alloc.malloc (ctx->alloc.user, sizeof (astar_search_t));
+	if (!search)
+		return NULL;
+
+	search->ctx = ctx;
+	search->ownsContext = 0;
+	if (init_astar_object (&search->astar, ctx, grid, 
+			       &search->solutionLength, start, end))
+		search->status = ASTAR_IN_PROGRESS;
+	else if (search->solutionLength == ASTAR_ERROR_NO_MEMORY)
+		search->status = ASTAR_OUT_OF_MEMORY;
+	else
+		search->status = ASTAR_NOT_FOUND;
+	return search;
+}
+
+astar_search_t *astar_begin (const char *grid, 
+			     int boundX, 
+			     int boundY, 
+			     int start, 
+			     int end)
+{
+	astar_context_t *ctx = astar_context_create (boundX, boundY);
+	if (!ctx)
+		return NULL;
+
+	astar_search_t *search = astar_context_begin (ctx, grid, start, end);
+	if (!search) {
+		astar_context_free (ctx);
+		return NULL;
+	}
+	search->ownsContext = 1;
+	return search;
+}
+
+astar_status_t astar_step (astar_search_t *search, int maxExpansions)
+{
+	if (search->status == ASTAR_IN_PROGRESS)
+		search->status = jpsExpand (&search->astar, maxExpansions);
+	return search->status;
+}
+
+int *astar_finish (astar_search_t *search, int *solLength)
+{
+	int *rv = finishSearch (&search->astar, search->status == ASTAR_FOUND);
+	// a path found may still have had no memory to go in
+	if (search->status == ASTAR_FOUND || search->status == ASTAR_OUT_OF_MEMORY)
+		*solLength = search->solutionLength;
+	else
+		*solLength = -1;
+
+	astar_allocator_t alloc = search->ctx->alloc;
+	if (search->ownsContext)
+		astar_context_free (search->ctx);
+	alloc.free (alloc.user, search);
+	return rv;
+}
+
+const astar_stats_t *astar_context_stats (const astar_context_t *ctx)
+{
+	return &ctx->stats;
+}
+
+// a context for a single query; if there isn't one, *solLength says why
+static astar_context_t *queryContext (int boundX, int boundY, int *solLength)
+{
+	astar_context_t *ctx = astar_context_create (boundX, boundY);
+	*solLength = ctx || boundX <= 0 || boundY <= 0 ? -1 : ASTAR_ERROR_NO_MEMORY;
+	return ctx;
+}
+
+int *astar_compute (const char *grid, 
+		    int *solLength, 
+		    int boundX, 
+		    int boundY, 
+		    int start, 
+		    int end)
+{
+	astar_context_t *ctx = queryContext (boundX, boundY, solLength);
+	if (!ctx)
+		return NULL;
+
+	int *rv = astar_context_compute (ctx, grid, solLength, start, end);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int *astar_compute_stats (const char *grid, 
+			  int *solLength, 
+			  int boundX, 
+			  int boundY, 
+			  int start, 
+			  int end,
+			  astar_stats_t *stats)
+{
+	memset (stats, 0, sizeof (astar_stats_t));
+	STAT (double allocStarted = now ());
+	astar_context_t *ctx = queryContext (boundX, boundY, solLength);
+	if (!ctx)
+		return NULL;
+	STAT (double allocTime = now () - allocStarted);
+
+	int *rv = astar_context_compute (ctx, grid, solLength, start, end);
+	*stats = ctx->stats;
+	STAT (stats->setupTime += allocTime);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int *astar_unopt_compute (const char *grid, 
+		    int *solLength, 
+		    int boundX, 
+		    int boundY, 
+		    int start, 
+		    int end)
+{
+	astar_context_t *ctx = queryContext (boundX, boundY, solLength);
+	if (!ctx)
+		return NULL;
+
+	int *rv = astar_context_unopt_compute (ctx, grid, solLength, start, end);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int *astar_compute_bidir (const char *grid, 
+			  int *solLength, 
+			  int boundX, 
+			  int boundY, 
+			  int start, 
+			  int end)
+{
+	astar_context_t *forward = queryContext (boundX, boundY, solLength);
+	astar_context_t *backward = queryContext (boundX, boundY, solLength);
+	int *rv = NULL;
+	if (forward && backward)
+		rv = astar_context_compute_bidir (forward, backward, grid, 
+						  solLength, start, end);
+	else if (forward || backward)
+		*solLength = ASTAR_ERROR_NO_MEMORY;
+	astar_context_free (forward);
+	astar_context_free (backward);
+	return rv;
+}
+
+int astar_compute_multi (const char *grid, 
+			 int boundX, 
+			 int boundY, 
+			 int start, 
+			 const int *goals, 
+			 int nGoals, 
+			 int k, 
+			 int **paths, 
+			 int *lengths)
+{
+	int solLength;
+	astar_context_t *ctx = queryContext (boundX, boundY, &solLength);
+	if (!ctx) {
+		for (int i = 0; i < nGoals; i++) {
+			paths[i] = NULL;
+			lengths[i] = solLength;
+		}
+		return 0;
+	}
+
+	int rv = astar_context_compute_multi (ctx, grid, start, goals, nGoals, 
+					      k, paths, lengths);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int astar_distance_field (const char *grid, 
+			  int boundX, 
+			  int boundY, 
+			  int goal, 
+			  astar_cost_t *costs, 
+			  unsigned char *next)
+{
+	int solLength;
+	astar_context_t *ctx = queryContext (boundX, boundY, &solLength);
+	if (!ctx)
+		return solLength;
+
+	int rv = astar_context_distance_field (ctx, grid, goal, costs, next);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int *astar_compute_jpsplus (const astar_jpsplus_t *jpsplus,
+			    int *solLength, 
+			    int start, 
+			    int end)
+{
+	astar_context_t *ctx = queryContext (jpsplus->bounds.x, jpsplus->bounds.y, solLength);
+	if (!ctx)
+		return NULL;
+
+	int *rv = astar_context_compute_jpsplus (ctx, jpsplus, solLength, start, end);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int *astar_compute_bitgrid (const astar_bitgrid_t *bitgrid,
+			    int *solLength, 
+			    int start, 
+			    int end)
+{
+	astar_context_t *ctx = queryContext (bitgrid->bounds.x, bitgrid->bounds.y, solLength);
+	if (!ctx)
+		return NULL;
+
+	int *rv = astar_context_compute_bitgrid (ctx, bitgrid, solLength, start, end);
+	astar_context_free (ctx);
+	return rv;
+}
+
+int *astar_compute_neighbours (const astar_neighbours_t *neighbours,
+			       int *solLength, 
+			       int start, 
+			       int end)
+{
+	astar_context_t *ctx = queryContext (neighbours->bounds.x, neighbours->bounds.y, solLength);
+	if (!ctx)
+		return NULL;
+
+	int *rv = astar_context_compute_neighbours (ctx, neighbours, solLength, start, end);
+	astar_context_free (ctx);
+	return rv;
 }
 
+int *astar_compute_components (const astar_components_t *components,
+			       const char *grid, 
+			       int *solLength, 
+			       int start, 
+			       int end)
+{
+	*solLength = -1;
+	if (!astar_components_connected (components, start, end))
+		return NULL;
+
+	return astar_compute (grid, solLength, components->bounds.x, 
+			      components->bounds.y, start, end);
+}
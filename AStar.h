@@ -1,11 +1,122 @@
 #ifndef ASTAR_H_
 #define ASTAR_H_
 
+#include "AStarAlloc.h"
+#include <stddef.h>
+
 typedef struct coord {
 	int x;
 	int y;
 } coord_t;
 
+/* Path costs. By default these are doubles, with a diagonal step costing
+   sqrt(2). Build the library (and anything that includes this header) with
+   ASTAR_INTEGER_COSTS defined to use fixed-point octile costs instead: a
+   straight step costs ASTAR_COST_STRAIGHT and a diagonal one
+   ASTAR_COST_DIAGONAL. That keeps the sqrt out of the search, halves the
+   size of the per-node cost array, and makes all priorities integers, which
+   the bucket queue needs to be exact.
+
+   Integer costs overflow for paths of more than about INT_MAX /
+   ASTAR_COST_DIAGONAL (1.5 million with the default scale) steps.
+ */
+#ifdef ASTAR_INTEGER_COSTS
+#ifndef ASTAR_COST_STRAIGHT
+#define ASTAR_COST_STRAIGHT 1000
+#endif
+#ifndef ASTAR_COST_DIAGONAL
+#define ASTAR_COST_DIAGONAL 1414
+#endif
+typedef int astar_cost_t;
+#else
+typedef double astar_cost_t;
+#endif
+
+/* Movement rules and the distance estimate, also fixed at build time, the
+   same way as ASTAR_INTEGER_COSTS, e.g.
+   "make CCARGS='-O2 -DASTAR_MOVEMENT=ASTAR_MOVE_STRAIGHT'".
+
+   ASTAR_MOVEMENT is one of
+   - ASTAR_MOVE_DIAGONAL (the default): 8 directions, and a diagonal step
+     may cut the corner of a blocked cell
+   - ASTAR_MOVE_NO_CORNER_CUTTING: 8 directions, but a diagonal step needs
+     both of the cells it passes between to be enterable
+   - ASTAR_MOVE_STRAIGHT: 4 directions only
+
+   Jump point search prunes differently under each, so each gets its own
+   jump() and neighbour rules; there's no dispatch between them at run
+   time. JPS+, the bit grid and the neighbourhood masks are only built for
+   ASTAR_MOVE_DIAGONAL, and their create functions return NULL under the
+   other two.
+
+   ASTAR_HEURISTIC is one of ASTAR_HEURISTIC_CHEBYSHEV (the default with
+   diagonal moves), ASTAR_HEURISTIC_OCTILE (closer to the real costs, so
+   fewer nodes get expanded) or ASTAR_HEURISTIC_MANHATTAN (the default
+   with ASTAR_MOVE_STRAIGHT, and only allowed with it, since it
+   overestimates paths that go diagonally).
+ */
+#define ASTAR_MOVE_DIAGONAL 0
+#define ASTAR_MOVE_NO_CORNER_CUTTING 1
+#define ASTAR_MOVE_STRAIGHT 2
+#ifndef ASTAR_MOVEMENT
+#define ASTAR_MOVEMENT ASTAR_MOVE_DIAGONAL
+#endif
+
+#define ASTAR_HEURISTIC_CHEBYSHEV 0
+#define ASTAR_HEURISTIC_OCTILE 1
+#define ASTAR_HEURISTIC_MANHATTAN 2
+#ifndef ASTAR_HEURISTIC
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+#define ASTAR_HEURISTIC ASTAR_HEURISTIC_MANHATTAN
+#else
+#define ASTAR_HEURISTIC ASTAR_HEURISTIC_CHEBYSHEV
+#endif
+#endif
+
+#if ASTAR_HEURISTIC == ASTAR_HEURISTIC_MANHATTAN && ASTAR_MOVEMENT != ASTAR_MOVE_STRAIGHT
+#error "the Manhattan distance is only admissible with ASTAR_MOVE_STRAIGHT"
+#endif
+
+/* The order cells are stored in, in grids and in the search's own per-cell
+   arrays, is fixed at build time as well. ASTAR_LAYOUT is one of
+   - ASTAR_LAYOUT_ROW_MAJOR (the default): cell (x, y) is at y * boundX + x
+   - ASTAR_LAYOUT_TILED: the map is cut into tiles of ASTAR_TILE_SIZE by
+     ASTAR_TILE_SIZE cells, stored a tile after another, a row of tiles at
+     a time, with the cells of each tile in row-major order within it
+
+   In a row-major grid on a wide map every step a jump takes up, down or
+   diagonally is a new cache line, and on maps thousands of cells wide a
+   new page too, and the same goes for the closed, gScores and cameFrom
+   arrays. An 8x8 tile of a grid is one 64-byte cache line, so those jumps
+   only move on to a new line every 8 steps, and to a new page far less
+   often. That's paid for in index arithmetic on every step, though, and
+   jump point search's long straight scans along rows hardly miss the
+   cache to begin with: on the 2048 to 8192 cell wide benchmark maps
+   tried, tiled builds came out between level with and a third slower
+   than row-major ones. So row-major stays the default; measure before
+   switching, on the maps that will be used.
+
+   Node indexes follow the layout too, everywhere: start and end, paths,
+   distance fields, and so on. astar_getIndexByWidth and
+   astar_getCoordByWidth convert between them and coordinates. A tiled
+   grid covers whole tiles, so it must have room for
+   astar_layout_size (boundX, boundY) cells, with the ones beyond the
+   edges of the map 0, and so must the arrays filled in a cell at a time,
+   such as a distance field's. astar_map_read_movingai and astar_map_open
+   return grids in the layout of the build.
+
+   JPS+, the bit grid and the neighbourhood masks work on whole rows at a
+   time, so they're only built with ASTAR_LAYOUT_ROW_MAJOR, and their
+   create functions return NULL with ASTAR_LAYOUT_TILED.
+ */
+#define ASTAR_LAYOUT_ROW_MAJOR 0
+#define ASTAR_LAYOUT_TILED 1
+#ifndef ASTAR_LAYOUT
+#define ASTAR_LAYOUT ASTAR_LAYOUT_ROW_MAJOR
+#endif
+
+#define ASTAR_TILE_SIZE 8
+
 /* Run A* pathfinding over uniform-cost 2d grids using jump point search.
 
    grid: 0 if obstructed, non-0 if non-obstructed (the value is ignored beyond that).
@@ -16,7 +127,13 @@ typedef struct coord {
    end: index of the ending node in the grid
 
    return value: Array of node indexes making up the solution, of length solLength, in reverse order
+
+   When there's no path, the return value is NULL and solLength -1. If the
+   search ran out of memory, it's NULL and ASTAR_ERROR_NO_MEMORY instead,
+   here and in every other search that reports a length. The library
+   never exits the program when memory runs out.
  */
+#define ASTAR_ERROR_NO_MEMORY -2
 
 int *astar_compute (const char *grid, 
 		    int *solLength, 
@@ -32,10 +149,569 @@ int *astar_unopt_compute (const char *grid,
 		    int start, 
 		    int end);
 
+/* A search context holds the per-map working memory of a search: the open
+   queue and the closed, gScores and cameFrom arrays. astar_compute allocates
+   and frees one on every call; if you run many queries against maps of the
+   same size, create a context once and pass it to astar_context_compute
+   instead, which resets it in constant time between queries.
+
+   A context is not safe to use from several threads at once. The grid
+   passed in each query must have the dimensions the context was created
+   with, but it may be a different grid every time.
+ */
+
+typedef struct astar_context astar_context_t;
+
+/* returns NULL if allocation fails or the bounds are not positive */
+astar_context_t *astar_context_create (int boundX, int boundY);
+
+/* The data structure used for the open list. The default is a 4-ary heap.
+   A radix heap relies on the estimates being consistent, as the built-in
+   ones are, and wins on large open maps; a bucket queue orders by the
+   integer part of each priority only, so it's only exact with integer
+   costs (ASTAR_INTEGER_COSTS), and it suits small cost ranges best. */
+typedef enum astar_open_list {
+	ASTAR_OPEN_BINARY_HEAP,
+	ASTAR_OPEN_QUATERNARY_HEAP,
+	ASTAR_OPEN_RADIX_HEAP,
+	ASTAR_OPEN_BUCKET_QUEUE
+} astar_open_list_t;
+
+astar_context_t *astar_context_create_with_open_list (int boundX, 
+						      int boundY, 
+						      astar_open_list_t openList);
+
+/* A context whose memory, the open list as it grows included, comes from
+   allocator instead of malloc (see AStarAlloc.h); NULL is malloc. So do
+   the paths its searches return, which must be given back to allocator's
+   free rather than free(). The hooks are copied, but their user data must
+   stay alive for as long as the context and its paths do. */
+astar_context_t *astar_context_create_with_allocator (int boundX, 
+						      int boundY, 
+						      astar_open_list_t openList,
+						      const astar_allocator_t *allocator);
+
+/* Makes the paths searches on ctx return come from allocator from now on,
+   e.g. an arena that's reset after every query; NULL goes back to the
+   context's own allocator. The rest of a context's memory, the open list
+   included, is kept from one search to the next, so a context that lives
+   as long as its worker does doesn't allocate anything else once it has
+   grown to fit its searches. */
+void astar_context_set_path_allocator (astar_context_t *ctx, 
+				       const astar_allocator_t *allocator);
+
+void astar_context_free (astar_context_t *ctx);
+
+int *astar_context_compute (astar_context_t *ctx,
+			    const char *grid, 
+			    int *solLength, 
+			    int start, 
+			    int end);
+
+int *astar_context_unopt_compute (astar_context_t *ctx,
+				  const char *grid, 
+				  int *solLength, 
+				  int start, 
+				  int end);
+
+
+/* Results without allocation. astar_context_compute_into writes the path,
+   in the same form astar_compute returns it, into a buffer of the
+   caller's. astar_context_compute_waypoints only writes the points where
+   the path turns, in the order they're walked: the start, the turns, and
+   the goal, so a path in a straight line is just its two ends. The path
+   between two waypoints is always a straight or diagonal line.
+
+   capacity: the number of ints path or waypoints has room for; a path has
+             at most boundX * boundY nodes
+
+   return value: the number of nodes in the path, or of waypoints, -1 if
+   there's no path, or ASTAR_ERROR_NO_MEMORY. If that's more than capacity,
+   nothing was written, and the query has to be run again with a big
+   enough buffer.
+ */
+int astar_context_compute_into (astar_context_t *ctx,
+				const char *grid, 
+				int start, 
+				int end, 
+				int *path, 
+				int capacity);
+
+int astar_context_compute_waypoints (astar_context_t *ctx,
+				     const char *grid, 
+				     int start, 
+				     int end, 
+				     int *waypoints, 
+				     int capacity);
+
+
+/* Bounded-suboptimal search. With a weight w above 1 on a context, every
+   search run on it that heads for a single goal (all but the multi-goal
+   searches and distance fields) orders its open list by g + w * h instead
+   of g + h. That makes it head for the goal more greedily, expanding
+   fewer nodes, and the paths it finds cost at most w times as much as the
+   shortest ones.
+
+   returns 0 and leaves ctx as it was if weight is less than 1 (or NaN),
+   or allocation fails; 1 is the default, for shortest paths
+ */
+int astar_context_set_weight (astar_context_t *ctx, double weight);
+
+/* Anytime search: a first path quickly, then better ones while the budget
+   lasts. The first search runs with the given weight, all the way to the
+   end; after that, searches with smaller and smaller weights, down to 1,
+   try to improve on it, until they've expanded maxExpansions nodes
+   between them (no limit if it's negative). The context's own weight is
+   left as it was.
+
+   bound: out-parameter, the smallest weight a search finished with; the
+          path returned costs at most bound times as much as the shortest
+          path, and it is a shortest path if bound is 1
+
+   return value: the best path found, as astar_compute returns it, or NULL
+   if there is no path, allocation fails, or weight is less than 1; if
+   memory runs out after a path has been found, that path is returned
+ */
+int *astar_context_compute_anytime (astar_context_t *ctx,
+				    const char *grid,
+				    int *solLength,
+				    int start,
+				    int end,
+				    double weight,
+				    int maxExpansions,
+				    double *bound);
+
+
+/* Bidirectional jump point search: one search forward from the start and
+   one backward from the goal, taking turns, and stopping once neither can
+   find a shorter path than where they've met. The paths are as short as
+   astar_compute's, though where there are several shortest paths it may
+   pick another one.
+
+   It pays off when one end is much easier to search from than the other.
+   Above all, when the goal is in a small area sealed off from the start,
+   the backward half runs out of nodes and the query ends there, instead
+   of after searching everything the start can reach; the same goes for
+   goals at the end of long dead ends. Otherwise it does more work than
+   astar_compute: on open maps, most of the time of jump point search goes
+   into the jumps scanning the map rather than into expanding nodes, and
+   each half does its own scanning.
+
+   astar_context_compute_bidir uses one context for each half; they must
+   be two different contexts with the same bounds. The statistics of each
+   cover its half of the search.
+ */
+int *astar_compute_bidir (const char *grid, 
+			  int *solLength, 
+			  int boundX, 
+			  int boundY, 
+			  int start, 
+			  int end);
+
+int *astar_context_compute_bidir (astar_context_t *forwardCtx,
+				  astar_context_t *backwardCtx,
+				  const char *grid, 
+				  int *solLength, 
+				  int start, 
+				  int end);
+
+
+/* One-to-many searches, for when a search from one start to each of many
+   goals would search the same ground over and over again.
+
+   astar_context_compute_multi runs a single search from start (Dijkstra's
+   algorithm, with jump point search) that stops once k of the goals have
+   been reached, the k nearest ones; if k is 0 or less, or more than the
+   number of goals, it runs until it has reached all the goals it can.
+   paths[i] and lengths[i] get the path to goals[i], as astar_compute would
+   return it, or NULL and -1 if the search didn't get there, or NULL and
+   ASTAR_ERROR_NO_MEMORY if it ran out of memory first. If components
+   are attached to the context, goals they say can't be reached don't
+   count, so the search can stop before it has searched everything.
+
+   return value: the number of paths returned
+ */
+int astar_compute_multi (const char *grid, 
+			 int boundX, 
+			 int boundY, 
+			 int start, 
+			 const int *goals, 
+			 int nGoals, 
+			 int k, 
+			 int **paths, 
+			 int *lengths);
+
+int astar_context_compute_multi (astar_context_t *ctx,
+				 const char *grid, 
+				 int start, 
+				 const int *goals, 
+				 int nGoals, 
+				 int k, 
+				 int **paths, 
+				 int *lengths);
+
+/* A distance field, for moving many units towards the same goal: one pass
+   over the whole grid that finds the cost of the shortest path from every
+   cell to the goal, with the same costs as astar_compute, and which way to
+   step to follow it. Any unit can then walk to the goal by looking up the
+   direction of the cell it's in, with no search of its own.
+
+   costs and next must have room for astar_layout_size (boundX, boundY)
+   entries, indexed like the grid in the layout of the build; next may be
+   NULL if only the costs are wanted. costs get -1, and next
+   ASTAR_NO_DIRECTION, for cells that have no path to the goal; the goal
+   itself gets a cost of 0 and ASTAR_NO_DIRECTION. Directions are 0 to 7
+   for north (y - 1), north-east, east (x + 1) and so on clockwise.
+
+   return value: 0, -1 if the goal is out of bounds or the context can't be
+   allocated, or ASTAR_ERROR_NO_MEMORY if memory runs out on the way,
+   which leaves costs and next half filled in
+ */
+#define ASTAR_NO_DIRECTION 8
+
+int astar_distance_field (const char *grid, 
+			  int boundX, 
+			  int boundY, 
+			  int goal, 
+			  astar_cost_t *costs, 
+			  unsigned char *next);
+
+int astar_context_distance_field (astar_context_t *ctx,
+				  const char *grid, 
+				  int goal, 
+				  astar_cost_t *costs, 
+				  unsigned char *next);
+
+
+/* Searches that run a bit at a time, for when a whole search at once would
+   take too long, e.g. within a frame of a game loop. astar_begin sets up a
+   jump point search and astar_step then expands at most maxExpansions
+   nodes of it per call, until it returns ASTAR_FOUND or ASTAR_NOT_FOUND.
+   astar_finish returns the path, as astar_compute would, and frees the
+   search; it can also be called early to abandon one.
+
+   astar_begin allocates a context for the search. astar_context_begin
+   borrows ctx instead, which then must not be used for anything else until
+   astar_finish has been called. Several searches can be in progress at
+   once as long as each has its own context. The grid must not change while
+   a search is in progress.
+
+   Both return NULL only if allocation fails; for a bad start or end, the
+   first step returns ASTAR_NOT_FOUND. A search that runs out of memory
+   returns ASTAR_OUT_OF_MEMORY, and astar_finish then gives NULL and
+   ASTAR_ERROR_NO_MEMORY; so does astar_finish after ASTAR_FOUND if there
+   isn't the memory for the path.
+ */
+
+typedef struct astar_search astar_search_t;
+
+typedef enum astar_status {
+	ASTAR_IN_PROGRESS,
+	ASTAR_FOUND,
+	ASTAR_NOT_FOUND,
+	ASTAR_OUT_OF_MEMORY
+} astar_status_t;
+
+astar_search_t *astar_begin (const char *grid,
+			     int boundX,
+			     int boundY,
+			     int start,
+			     int end);
+
+astar_search_t *astar_context_begin (astar_context_t *ctx,
+				     const char *grid,
+				     int start,
+				     int end);
+
+astar_status_t astar_step (astar_search_t *search, int maxExpansions);
+
+int *astar_finish (astar_search_t *search, int *solLength);
+
+
+/* JPS+: for maps that don't change, the jump points can be found ahead of
+   time. astar_jpsplus_create walks the whole grid once and records, for
+   every cell and each of the 8 directions, how far it is to the next jump
+   point or wall; queries then replace jump()'s cell-by-cell scanning with
+   table lookups and return the same paths as astar_compute.
+
+   The tables take 32 bytes per cell. They keep a pointer to the grid, which
+   must stay alive and unchanged for as long as the tables are used; if the
+   grid changes, create new tables. The tables are only read by queries, so
+   several threads can share them as long as each uses its own context.
+ */
+
+typedef struct astar_jpsplus astar_jpsplus_t;
+
+/* returns NULL if allocation fails or the bounds are not positive */
+astar_jpsplus_t *astar_jpsplus_create (const char *grid, 
+				       int boundX, 
+				       int boundY);
+
+void astar_jpsplus_free (astar_jpsplus_t *jpsplus);
+
+/* The tables can be saved and used again, e.g. in a map file (see
+   AStarMap.h), instead of being recomputed every time. astar_jpsplus_tables
+   returns them, boundX * boundY * 8 ints. astar_jpsplus_create_from_tables
+   uses tables saved earlier for the same grid without copying them, so
+   they must stay alive for as long as the result is used.
+ */
+const int *astar_jpsplus_tables (const astar_jpsplus_t *jpsplus);
+
+/* returns NULL if allocation fails or the bounds are not positive */
+astar_jpsplus_t *astar_jpsplus_create_from_tables (const char *grid,
+						   int boundX,
+						   int boundY,
+						   const int *tables);
+
+int *astar_compute_jpsplus (const astar_jpsplus_t *jpsplus,
+			    int *solLength, 
+			    int start, 
+			    int end);
+
+/* ctx must have been created with the same bounds as the tables */
+int *astar_context_compute_jpsplus (astar_context_t *ctx,
+				    const astar_jpsplus_t *jpsplus,
+				    int *solLength, 
+				    int start, 
+				    int end);
+
+
+/* A bit-packed copy of a grid, for jumping over many cells at once: one bit
+   per cell, kept in both row-major and column-major order, so a quarter of
+   the size of a byte grid. Straight jumps scan 64 cells per step; on maps
+   with long open corridors this is much faster than astar_compute's jump().
+   The paths found are the same as astar_compute's.
+
+   astar_bitgrid_create copies the grid, so the original can be freed
+   afterwards. Use astar_bitgrid_set to change single cells in place; the
+   bit grid must not be changed while a query is running on it.
+ */
+
+typedef struct astar_bitgrid astar_bitgrid_t;
+
+/* returns NULL if allocation fails or the bounds are not positive */
+astar_bitgrid_t *astar_bitgrid_create (const char *grid, 
+				       int boundX, 
+				       int boundY);
+
+void astar_bitgrid_set (astar_bitgrid_t *bitgrid, int x, int y, int enterable);
+
+void astar_bitgrid_free (astar_bitgrid_t *bitgrid);
+
+int *astar_compute_bitgrid (const astar_bitgrid_t *bitgrid,
+			    int *solLength, 
+			    int start, 
+			    int end);
+
+/* ctx must have been created with the same bounds as the bit grid */
+int *astar_context_compute_bitgrid (astar_context_t *ctx,
+				    const astar_bitgrid_t *bitgrid,
+				    int *solLength, 
+				    int start, 
+				    int end);
+
+
+/* Neighbourhood masks: a byte per cell with a bit for each of its 8
+   neighbours, set if the neighbour is enterable. With them, a step of a
+   jump is a single load and a lookup in a 256 by 8 table of forced
+   neighbours, instead of reading the grid around every cell it passes.
+   The paths found are the same as astar_compute's.
+
+   astar_neighbours_create builds the masks in one pass over the grid, and
+   doesn't keep the grid. Use astar_neighbours_set to change single cells
+   in place, which patches the masks of the cell's 8 neighbours; the masks
+   must not be changed while a query is running on them.
+ */
+
+typedef struct astar_neighbours astar_neighbours_t;
+
+/* returns NULL if allocation fails or the bounds are not positive */
+astar_neighbours_t *astar_neighbours_create (const char *grid, 
+					     int boundX, 
+					     int boundY);
+
+void astar_neighbours_set (astar_neighbours_t *neighbours, int x, int y, int enterable);
+
+void astar_neighbours_free (astar_neighbours_t *neighbours);
+
+int *astar_compute_neighbours (const astar_neighbours_t *neighbours,
+			       int *solLength, 
+			       int start, 
+			       int end);
+
+/* ctx must have been created with the same bounds as the masks */
+int *astar_context_compute_neighbours (astar_context_t *ctx,
+				       const astar_neighbours_t *neighbours,
+				       int *solLength, 
+				       int start, 
+				       int end);
+
+
+/* Connected components, for turning away queries that have no path without
+   searching. An unreachable goal otherwise costs a search of everything the
+   start can reach, which on maps with lots of sealed-off areas makes these
+   the slowest queries of all.
+
+   astar_components_create labels every cell with its component in one
+   pass over the grid, and astar_components_connected then tells in
+   constant time whether the searches would find a path. If cells change,
+   tell the components with astar_components_set: opening a cell costs
+   about as much as the smaller components it joins are big, and blocking
+   one costs next to nothing unless it splits its component in two, and
+   then about as much as the smaller piece is big.
+
+   The components take 16 bytes per cell, and don't keep a pointer to the
+   grid. Attach them to a context with astar_context_set_components to have
+   every query on the context check them before searching.
+ */
+
+typedef struct astar_components astar_components_t;
+
+/* returns NULL if allocation fails or the bounds are not positive */
+astar_components_t *astar_components_create (const char *grid,
+					     int boundX,
+					     int boundY);
+
+void astar_components_set (astar_components_t *components,
+			   int x,
+			   int y,
+			   int enterable);
+
+void astar_components_free (astar_components_t *components);
+
+/* 1 if there's a path from start to end, 0 if not */
+int astar_components_connected (const astar_components_t *components,
+				int start,
+				int end);
+
+/* astar_compute, but returning NULL before allocating anything if the
+   components say there's no path */
+int *astar_compute_components (const astar_components_t *components,
+			       const char *grid,
+			       int *solLength,
+			       int start,
+			       int end);
+
+/* ctx must have been created with the same bounds as the components;
+   returns 0 and leaves ctx as it was if it wasn't. The components must
+   stay alive for as long as they're attached; pass NULL to detach them. */
+int astar_context_set_components (astar_context_t *ctx,
+				  const astar_components_t *components);
+
+
+/* Landmarks (ALT), for maps where the distance estimate is far below the
+   real costs, like mazes and maps full of dead ends, and the searches
+   expand whole regions the path never goes near.
+
+   astar_landmarks_create picks a few landmark cells, each as far as it can
+   get from the ones before it, and records the cost of the shortest path
+   from every cell to each of them, with a distance field. By the triangle
+   inequality, how much farther one cell is from a landmark than another
+   is a lower bound on the cost between the two, and queries on a context
+   the landmarks are attached to use the largest of those bounds as the
+   estimate whenever it beats the usual one. The paths are still the
+   shortest ones.
+
+   The tables take count * sizeof (astar_cost_t) bytes per cell, or
+   count * 2 if quantized: stored as 16-bit multiples of a scale per
+   landmark, its longest distance over 65534. That gives somewhat smaller
+   estimates, since they have to stay below the real costs whichever way
+   the distances were rounded. Creating them costs count + 1 distance
+   fields. They don't keep a pointer to the grid; if it changes, create
+   new ones. They're only read by queries, so several contexts can share
+   them.
+ */
+
+typedef struct astar_landmarks astar_landmarks_t;
+
+/* count: the number of landmarks; 4 to 16 is the usual range
+
+   returns NULL if allocation fails, the bounds or count are not positive,
+   or the grid has no enterable cells
+ */
+astar_landmarks_t *astar_landmarks_create (const char *grid,
+					   int boundX,
+					   int boundY,
+					   int count,
+					   int quantized);
+
+void astar_landmarks_free (astar_landmarks_t *landmarks);
+
+/* The tables can be saved and used again like the JPS+ tables, e.g. in a
+   map file. astar_landmarks_tables returns them, with a header, and their
+   size in bytes; astar_landmarks_create_from_tables uses tables saved
+   earlier for the same grid without copying them, so they must stay
+   alive for as long as the result is used.
+
+   astar_landmarks_create_from_tables returns NULL if allocation fails or
+   the tables aren't landmark tables for the given bounds and the cost
+   type and layout of this build (ASTAR_INTEGER_COSTS or not, and
+   ASTAR_LAYOUT)
+ */
+const void *astar_landmarks_tables (const astar_landmarks_t *landmarks, size_t *size);
+
+astar_landmarks_t *astar_landmarks_create_from_tables (int boundX,
+						       int boundY,
+						       const void *tables,
+						       size_t size);
+
+/* ctx must have been created with the same bounds as the landmarks;
+   returns 0 and leaves ctx as it was if it wasn't. The landmarks must
+   stay alive for as long as they're attached; pass NULL to detach them. */
+int astar_context_set_landmarks (astar_context_t *ctx,
+				 const astar_landmarks_t *landmarks);
+
+
+/* Search statistics, for finding out why a query was slow. Build the
+   library with ASTAR_STATS defined (make CCARGS="-O2 -DASTAR_STATS") to
+   have the searches count these; otherwise the counters are compiled out
+   and always read as zero.
+
+   expanded: nodes taken off the open list and expanded
+   jumpCalls: jumps tried from expanded nodes
+   cellsScanned: cells the jumps stepped over, one at a time or a word at a
+                 time on a bit grid; JPS+ table lookups don't count
+   inserts, deleteMins, changePriorities: open list operations
+   peakOpen: the largest the open list got
+   setupTime, searchTime, recordTime: wall clock seconds spent setting up
+                 the search (including allocation, for astar_compute_stats),
+                 searching, and building the path
+ */
+
+typedef struct astar_stats {
+	long expanded;
+	long jumpCalls;
+	long cellsScanned;
+	long inserts;
+	long deleteMins;
+	long changePriorities;
+	int peakOpen;
+	double setupTime;
+	double searchTime;
+	double recordTime;
+} astar_stats_t;
+
+/* astar_compute, but also fill in stats */
+int *astar_compute_stats (const char *grid, 
+			  int *solLength, 
+			  int boundX, 
+			  int boundY, 
+			  int start, 
+			  int end,
+			  astar_stats_t *stats);
+
+/* the statistics of the last query run on ctx */
+const astar_stats_t *astar_context_stats (const astar_context_t *ctx);
+
 
 /* Compute cell indexes from cell coordinates and the grid width */
 int astar_getIndexByWidth (int width, int x, int y);
 
 /* Compute coordinates from a cell index and the grid width */
 void astar_getCoordByWidth (int width, int node, int *x, int *y);
+
+/* How many cells a grid, or an array with an entry per cell, needs room
+   for in the layout of this build (see ASTAR_LAYOUT); boundX * boundY
+   unless the layout is tiled. */
+int astar_layout_size (int boundX, int boundY);
 #endif
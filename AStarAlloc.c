@@ -0,0 +1,196 @@
+#include "AStarAlloc.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void *libcMalloc (void *user, size_t size)
+{
+	(void) user;
+	return malloc (size);
+}
+
+static void *libcRealloc (void *user, void *ptr, size_t oldSize, size_t newSize)
+{
+	(void) user; (void) oldSize;
+	return realloc (ptr, newSize);
+}
+
+static void libcFree (void *user, void *ptr)
+{
+	(void) user;
+	free (ptr);
+}
+
+const astar_allocator_t astar_default_allocator = {
+	libcMalloc, libcRealloc, libcFree, NULL
+};
+
+
+// Arenas
+
+// everything handed out is aligned for any type, as malloc's is
+#define ALIGNMENT 16
+#define ALIGN(n) (((n) + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1))
+
+typedef struct chunk {
+	struct chunk *next;
+	size_t size;
+	size_t used;
+} chunk;
+
+#define CHUNK_HEADER ALIGN (sizeof (chunk))
+
+// chunks is a list of the blocks, the newest first, and only the newest is
+// handed out of; size is how big to make a new one. last is the last
+// allocation made, the one that can be grown or given back in place.
+struct astar_arena {
+	chunk *chunks;
+	size_t size;
+	size_t used;
+	char *last;
+	astar_allocator_t allocator;
+};
+
+static char *chunkData (chunk *c)
+{
+	return (char *) c + CHUNK_HEADER;
+}
+
+static chunk *addChunk (astar_arena_t *arena, size_t size)
+{
+	if (size > SIZE_MAX - CHUNK_HEADER)
+		return NULL;
+	chunk *c = malloc (CHUNK_HEADER + size);
+	if (!c)
+		return NULL;
+
+	c->next = arena->chunks;
+	c->size = size;
+	c->used = 0;
+	arena->chunks = c;
+	return c;
+}
+
+static void *arenaMalloc (void *user, size_t size)
+{
+	astar_arena_t *arena = user;
+	if (size > SIZE_MAX - ALIGNMENT)
+		return NULL;
+
+	size = ALIGN (size);
+	chunk *c = arena->chunks;
+	if (!c || c->size - c->used < size) {
+		c = addChunk (arena, size > arena->size ? size : arena->size);
+		if (!c)
+			return NULL;
+	}
+
+	char *p = chunkData (c) + c->used;
+	c->used += size;
+	arena->used += size;
+	arena->last = p;
+	return p;
+}
+
+static void *arenaRealloc (void *user, void *ptr, size_t oldSize, size_t newSize)
+{
+	astar_arena_t *arena = user;
+	if (!ptr)
+		return arenaMalloc (arena, newSize);
+
+	// the last allocation grows, or shrinks, where it is if there's room
+	chunk *c = arena->chunks;
+	if (ptr == arena->last && newSize <= SIZE_MAX - ALIGNMENT) {
+		size_t offset = (char *) ptr - chunkData (c);
+		size_t size = ALIGN (newSize);
+		if (size <= c->size - offset) {
+			arena->used = arena->used - (c->used - offset) + size;
+			c->used = offset + size;
+			return ptr;
+		}
+	}
+
+	if (newSize <= oldSize)
+		return ptr;
+	void *p = arenaMalloc (arena, newSize);
+	if (p)
+		memcpy (p, ptr, oldSize);
+	return p;
+}
+
+static void arenaFree (void *user, void *ptr)
+{
+	astar_arena_t *arena = user;
+	if (!ptr || ptr != arena->last)
+		return;
+
+	chunk *c = arena->chunks;
+	size_t offset = (char *) ptr - chunkData (c);
+	arena->used -= c->used - offset;
+	c->used = offset;
+	arena->last = NULL;
+}
+
+astar_arena_t *astar_arena_create (size_t size)
+{
+	astar_arena_t *arena = calloc (1, sizeof (astar_arena_t));
+	if (!arena)
+		return NULL;
+
+	arena->size = ALIGN (size);
+	arena->allocator = (astar_allocator_t) {
+		arenaMalloc, arenaRealloc, arenaFree, arena
+	};
+	if (arena->size && !addChunk (arena, arena->size)) {
+		free (arena);
+		return NULL;
+	}
+	return arena;
+}
+
+void astar_arena_reset (astar_arena_t *arena)
+{
+	arena->used = 0;
+	arena->last = NULL;
+	if (!arena->chunks)
+		return;
+	if (!arena->chunks->next) {
+		arena->chunks->used = 0;
+		return;
+	}
+
+	// it took more than one block, so make the one block that big; if
+	// that fails, the next allocation will try again
+	size_t total = 0;
+	while (arena->chunks) {
+		chunk *next = arena->chunks->next;
+		total += arena->chunks->size;
+		free (arena->chunks);
+		arena->chunks = next;
+	}
+	arena->size = total;
+	addChunk (arena, total);
+}
+
+void astar_arena_free (astar_arena_t *arena)
+{
+	if (!arena)
+		return;
+
+	while (arena->chunks) {
+		chunk *next = arena->chunks->next;
+		free (arena->chunks);
+		arena->chunks = next;
+	}
+	free (arena);
+}
+
+const astar_allocator_t *astar_arena_allocator (astar_arena_t *arena)
+{
+	return &arena->allocator;
+}
+
+size_t astar_arena_used (const astar_arena_t *arena)
+{
+	return arena->used;
+}
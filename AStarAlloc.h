@@ -0,0 +1,70 @@
+#ifndef ASTARALLOC_H_
+#define ASTARALLOC_H_
+
+#include <stddef.h>
+
+/* Where search contexts get their memory from: their per-node arrays, the
+   open list as it grows during a search, and the paths they return. By
+   default that's malloc, realloc and free; a server that doesn't want
+   searches to fragment its heap, or that wants to cap how much memory they
+   take, can pass its own hooks to astar_context_create_with_allocator, and
+   have the paths come from somewhere else again with
+   astar_context_set_path_allocator.
+
+   realloc is told the old size of the block, and both it and malloc
+   return NULL when they can't give the memory, as the C library's do.
+   free must accept NULL. user is passed to every hook as is. */
+typedef struct astar_allocator {
+	void *(*malloc) (void *user, size_t size);
+	void *(*realloc) (void *user, void *ptr, size_t oldSize, size_t newSize);
+	void (*free) (void *user, void *ptr);
+	void *user;
+} astar_allocator_t;
+
+// the C library's malloc, realloc and free
+extern const astar_allocator_t astar_default_allocator;
+
+/* A bump arena: memory handed out of big blocks one after another, and
+   given back all at once by astar_arena_reset. Freeing a block in between
+   only gives back its memory if it was the last one handed out, and
+   growing the last block grows it where it is.
+
+   The usual way is a context and an arena per worker, both kept for as
+   long as the worker runs, with the paths from the arena, and the arena
+   reset once the result of each query has been used:
+
+	astar_context_t *ctx = astar_context_create (boundX, boundY);
+	astar_context_set_path_allocator (ctx, astar_arena_allocator (arena));
+	...
+	int *path = astar_context_compute (ctx, grid, &length, start, end);
+	...
+	astar_arena_reset (arena);
+
+   Creating a context from an arena for every query would work too, but
+   would set up all of its per-node arrays again each time, at a cost that
+   grows with the map rather than with the search.
+
+   If the memory handed out takes more than the arena has, more blocks are
+   added, and the next reset replaces them all with one block big enough
+   for the lot, so from then on it fits in one. An arena is not safe to use
+   from several threads at once. */
+typedef struct astar_arena astar_arena_t;
+
+/* size: how many bytes the first block holds
+
+   returns NULL if allocation fails */
+astar_arena_t *astar_arena_create (size_t size);
+
+// hands back all the memory handed out
+void astar_arena_reset (astar_arena_t *arena);
+
+void astar_arena_free (astar_arena_t *arena);
+
+/* hooks that allocate from the arena; they stay valid for as long as the
+   arena does */
+const astar_allocator_t *astar_arena_allocator (astar_arena_t *arena);
+
+// how many bytes have been handed out since the last reset
+size_t astar_arena_used (const astar_arena_t *arena);
+
+#endif
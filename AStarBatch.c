@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200112L
+#include "AStarBatch.h"
+#include "AStar.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+// the queries a worker still has to run, [next, end)
+typedef struct deque {
+	pthread_mutex_t lock;
+	int next;
+	int end;
+} deque;
+
+typedef struct batch {
+	const char *grid;
+	int boundX;
+	int boundY;
+	const astar_query_t *queries;
+	astar_result_t *results;
+	int nworkers;
+	deque *deques;
+} batch;
+
+typedef struct worker {
+	batch *batch;
+	int id;
+} worker;
+
+// take the next query from our own deque, or -1 if it's empty
+static int popOwn (deque *d)
+{
+	int rv = -1;
+	pthread_mutex_lock (&d->lock);
+	if (d->next < d->end)
+		rv = d->next++;
+	pthread_mutex_unlock (&d->lock);
+	return rv;
+}
+
+// move the back half of some other worker's queries into our own deque;
+// returns 0 if there was nothing left anywhere
+static int steal (batch *b, int id)
+{
+	for (int i = 1; i < b->nworkers; i++) {
+		deque *victim = &b->deques[(id + i) % b->nworkers];
+		pthread_mutex_lock (&victim->lock);
+		int left = victim->end - victim->next;
+		if (left > 0) {
+			int mid = victim->end - (left + 1) / 2;
+			int end = victim->end;
+			victim->end = mid;
+			pthread_mutex_unlock (&victim->lock);
+
+			deque *own = &b->deques[id];
+			pthread_mutex_lock (&own->lock);
+			own->next = mid;
+			own->end = end;
+			pthread_mutex_unlock (&own->lock);
+			return 1;
+		}
+		pthread_mutex_unlock (&victim->lock);
+	}
+	return 0;
+}
+
+static void *work (void *arg)
+{
+	worker *w = arg;
+	batch *b = w->batch;
+
+	astar_context_t *ctx = astar_context_create (b->boundX, b->boundY);
+	// someone else will have to pick up our share
+	if (!ctx)
+		return NULL;
+
+	for (;;) {
+		int i = popOwn (&b->deques[w->id]);
+		if (i < 0) {
+			if (!steal (b, w->id))
+				break;
+			continue;
+		}
+
+		astar_result_t *r = &b->results[i];
+		r->path = astar_context_compute (ctx, b->grid, &r->length,
+						 b->queries[i].start,
+						 b->queries[i].end);
+	}
+
+	astar_context_free (ctx);
+	return NULL;
+}
+
+int astar_compute_batch (const char *grid,
+			 int boundX,
+			 int boundY,
+			 const astar_query_t *queries,
+			 int n,
+			 astar_result_t *results,
+			 int nthreads)
+{
+	// until they're run
+	for (int i = 0; i < n; i++) {
+		results[i].path = NULL;
+		results[i].length = ASTAR_ERROR_NO_MEMORY;
+	}
+
+	if (nthreads < 1)
+		return -1;
+	if (n <= 0)
+		return 0;
+	if (nthreads > n)
+		nthreads = n;
+
+	batch b;
+	b.grid = grid;
+	b.boundX = boundX;
+	b.boundY = boundY;
+	b.queries = queries;
+	b.results = results;
+	b.nworkers = nthreads;
+	b.deques = malloc (nthreads * sizeof (deque));
+	worker *workers = malloc (nthreads * sizeof (worker));
+	pthread_t *threads = malloc (nthreads * sizeof (pthread_t));
+	int *started = malloc (nthreads * sizeof (int));
+	if (!b.deques || !workers || !threads || !started) {
+		free (b.deques);
+		free (workers);
+		free (threads);
+		free (started);
+		return ASTAR_ERROR_NO_MEMORY;
+	}
+
+	for (int i = 0; i < nthreads; i++) {
+		pthread_mutex_init (&b.deques[i].lock, NULL);
+		b.deques[i].next = (long) n * i / nthreads;
+		b.deques[i].end = (long) n * (i + 1) / nthreads;
+		workers[i].batch = &b;
+		workers[i].id = i;
+	}
+
+	// worker 0 is the calling thread; if a thread can't be started, the
+	// others steal its queries
+	for (int i = 1; i < nthreads; i++)
+		started[i] = !pthread_create (&threads[i], NULL, work, &workers[i]);
+
+	work (&workers[0]);
+
+	for (int i = 1; i < nthreads; i++)
+		if (started[i])
+			pthread_join (threads[i], NULL);
+
+	// if no worker managed to get a context, some queries never ran
+	int complete = 1;
+	for (int i = 0; i < nthreads; i++)
+		if (b.deques[i].next < b.deques[i].end)
+			complete = 0;
+
+	for (int i = 0; i < nthreads; i++)
+		pthread_mutex_destroy (&b.deques[i].lock);
+	free (b.deques);
+	free (workers);
+	free (threads);
+	free (started);
+
+	return complete ? 0 : ASTAR_ERROR_NO_MEMORY;
+}
@@ -0,0 +1,45 @@
+#ifndef ASTARBATCH_H_
+#define ASTARBATCH_H_
+
+/* Batch queries: run many searches against the same grid on several
+   threads at once.
+
+   The grid is shared by all threads and only read. Each worker thread has
+   its own search context, so the per-query cost is the same as with
+   astar_context_compute. Queries are handed out in contiguous runs, and a
+   worker that runs out of queries steals half of what's left from another
+   worker, so a few long queries don't leave the other threads idle.
+
+   Results come back in query order: results[i] belongs to queries[i],
+   whichever thread happened to run it. The path of each result is what
+   astar_compute would have returned, and must be freed by the caller.
+ */
+
+typedef struct astar_query {
+	int start;
+	int end;
+} astar_query_t;
+
+typedef struct astar_result {
+	int *path;
+	int length;
+} astar_result_t;
+
+/* nthreads: number of threads to run the queries on, including the calling
+   thread; 1 runs everything on the calling thread. Threads that can't be
+   started leave their queries to the others.
+
+   return value: 0 if every query was run, -1 if nthreads is less than 1,
+   or ASTAR_ERROR_NO_MEMORY if some queries couldn't be run for lack of
+   memory. Queries that weren't run get a NULL path and a length of
+   ASTAR_ERROR_NO_MEMORY, as do queries that ran out of memory on the way.
+ */
+int astar_compute_batch (const char *grid,
+			 int boundX,
+			 int boundY,
+			 const astar_query_t *queries,
+			 int n,
+			 astar_result_t *results,
+			 int nthreads);
+
+#endif
@@ -0,0 +1,257 @@
+#include "AStarCache.h"
+#include "AStar.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A cached query. Entries are kept in two doubly linked lists at once: the
+// least recently used list, and the chain of their hash bucket, which is
+// picked by the goal, so that all the paths to a goal are in one chain.
+// Free entries are chained through newer.
+typedef struct entry {
+	int start;
+	int end;
+	int *path; // NULL if there's no path
+	int length;
+	int newer;
+	int older;
+	int nextInBucket;
+	int prevInBucket;
+} entry;
+
+struct astar_cache {
+	int boundX;
+	int boundY;
+	int capacity;
+	entry *entries;
+	int freeEntry;
+	int newest;
+	int oldest;
+	int *buckets;
+	unsigned int bucketMask;
+	int hasVersion;
+	unsigned int version;
+	astar_context_t *ctx;
+	astar_cache_stats_t stats;
+};
+
+static int *bucketOf (astar_cache_t *cache, int end)
+{
+	unsigned int hash = (unsigned int) end * 2654435761u;
+	return &cache->buckets[(hash >> 16 ^ hash) & cache->bucketMask];
+}
+
+static void unlinkEntry (astar_cache_t *cache, int i)
+{
+	entry *e = &cache->entries[i];
+	if (e->newer >= 0)
+		cache->entries[e->newer].older = e->older;
+	else
+		cache->newest = e->older;
+	if (e->older >= 0)
+		cache->entries[e->older].newer = e->newer;
+	else
+		cache->oldest = e->newer;
+}
+
+// make an entry the most recently used one
+static void pushNewest (astar_cache_t *cache, int i)
+{
+	entry *e = &cache->entries[i];
+	e->newer = -1;
+	e->older = cache->newest;
+	if (cache->newest >= 0)
+		cache->entries[cache->newest].newer = i;
+	else
+		cache->oldest = i;
+	cache->newest = i;
+}
+
+static void removeEntry (astar_cache_t *cache, int i)
+{
+	entry *e = &cache->entries[i];
+	unlinkEntry (cache, i);
+	if (e->prevInBucket >= 0)
+		cache->entries[e->prevInBucket].nextInBucket = e->nextInBucket;
+	else
+		*bucketOf (cache, e->end) = e->nextInBucket;
+	if (e->nextInBucket >= 0)
+		cache->entries[e->nextInBucket].prevInBucket = e->prevInBucket;
+
+	free (e->path);
+	e->path = NULL;
+	e->newer = cache->freeEntry;
+	cache->freeEntry = i;
+}
+
+static void flush (astar_cache_t *cache)
+{
+	while (cache->newest >= 0)
+		removeEntry (cache, cache->newest);
+	cache->stats.flushes++;
+}
+
+astar_cache_t *astar_cache_create (int boundX, int boundY, int capacity)
+{
+	if (boundX <= 0 || boundY <= 0 || capacity <= 0)
+		return NULL;
+
+	astar_cache_t *cache = calloc (1, sizeof (astar_cache_t));
+	if (!cache)
+		return NULL;
+
+	// at least twice as many buckets as entries, to keep the chains short
+	int nBuckets = 1;
+	while (nBuckets < 2 * capacity)
+		nBuckets *= 2;
+
+	cache->boundX = boundX;
+	cache->boundY = boundY;
+	cache->capacity = capacity;
+	cache->bucketMask = nBuckets - 1;
+	cache->newest = cache->oldest = -1;
+	cache->entries = malloc (capacity * sizeof (entry));
+	cache->buckets = malloc (nBuckets * sizeof (int));
+	cache->ctx = astar_context_create (boundX, boundY);
+	if (!cache->entries || !cache->buckets || !cache->ctx) {
+		astar_cache_free (cache);
+		return NULL;
+	}
+
+	for (int i = 0; i < nBuckets; i++)
+		cache->buckets[i] = -1;
+	for (int i = 0; i < capacity; i++) {
+		cache->entries[i].path = NULL;
+		cache->entries[i].newer = i + 1 < capacity ? i + 1 : -1;
+	}
+	cache->freeEntry = 0;
+	return cache;
+}
+
+void astar_cache_free (astar_cache_t *cache)
+{
+	if (!cache)
+		return;
+
+	if (cache->entries)
+		for (int i = 0; i < cache->capacity; i++)
+			free (cache->entries[i].path);
+	free (cache->entries);
+	free (cache->buckets);
+	astar_context_free (cache->ctx);
+	free (cache);
+}
+
+// the first length + 1 nodes of a path, i.e. the path from its node at
+// length to its goal
+static int *copyPath (const int *path, int length)
+{
+	int *rv = malloc ((length + 1) * sizeof (int));
+	if (rv)
+		memcpy (rv, path, (length + 1) * sizeof (int));
+	return rv;
+}
+
+// Find a cached path that answers the query: the same query, or a path to
+// the same goal that goes through start. Returns the entry, or -1, and in
+// *length the length of the answer.
+static int lookup (astar_cache_t *cache, int start, int end, int *length)
+{
+	for (int i = *bucketOf (cache, end); i >= 0; i = cache->entries[i].nextInBucket) {
+		entry *e = &cache->entries[i];
+		if (e->end != end)
+			continue;
+
+		if (e->start == start) {
+			*length = e->length;
+			return i;
+		}
+
+		// paths run from the goal at 0 back to the start
+		for (int j = 0; e->path && j < e->length; j++)
+			if (e->path[j] == start) {
+				*length = j;
+				return i;
+			}
+	}
+	return -1;
+}
+
+static void store (astar_cache_t *cache, int start, int end, const int *path, int length)
+{
+	int *copy = NULL;
+	if (path) {
+		copy = copyPath (path, length);
+		// not worth failing the query over
+		if (!copy)
+			return;
+	}
+
+	if (cache->freeEntry < 0) {
+		removeEntry (cache, cache->oldest);
+		cache->stats.evictions++;
+	}
+
+	int i = cache->freeEntry;
+	entry *e = &cache->entries[i];
+	cache->freeEntry = e->newer;
+	e->start = start;
+	e->end = end;
+	e->path = copy;
+	e->length = path ? length : -1;
+
+	int *bucket = bucketOf (cache, end);
+	e->prevInBucket = -1;
+	e->nextInBucket = *bucket;
+	if (*bucket >= 0)
+		cache->entries[*bucket].prevInBucket = i;
+	*bucket = i;
+	pushNewest (cache, i);
+}
+
+int *astar_cache_compute (astar_cache_t *cache,
+			  const char *grid,
+			  unsigned int version,
+			  int *solLength,
+			  int start,
+			  int end)
+{
+	*solLength = -1;
+	int size = astar_layout_size (cache->boundX, cache->boundY);
+	if (start < 0 || start >= size || end < 0 || end >= size)
+		return NULL;
+
+	if (cache->hasVersion && version != cache->version)
+		flush (cache);
+	cache->hasVersion = 1;
+	cache->version = version;
+
+	int length;
+	int i = lookup (cache, start, end, &length);
+	if (i >= 0) {
+		entry *e = &cache->entries[i];
+		if (e->start == start)
+			cache->stats.hits++;
+		else
+			cache->stats.suffixHits++;
+		unlinkEntry (cache, i);
+		pushNewest (cache, i);
+
+		if (!e->path)
+			return NULL;
+		int *rv = copyPath (e->path, length);
+		*solLength = rv ? length : ASTAR_ERROR_NO_MEMORY;
+		return rv;
+	}
+
+	cache->stats.misses++;
+	int *rv = astar_context_compute (cache->ctx, grid, solLength, start, end);
+	// running out of memory says nothing about whether there's a path
+	if (*solLength != ASTAR_ERROR_NO_MEMORY)
+		store (cache, start, end, rv, *solLength);
+	return rv;
+}
+
+const astar_cache_stats_t *astar_cache_stats (const astar_cache_t *cache)
+{
+	return &cache->stats;
+}
@@ -0,0 +1,62 @@
+#ifndef ASTARCACHE_H_
+#define ASTARCACHE_H_
+
+/* A path cache, for queries that repeat: units patrolling the same route,
+   or queueing up to the same building. It keeps the paths of the most
+   recent queries, up to a fixed number of them, and answers a query from
+   them without searching if it can:
+
+   - if the same query has been run before, with the same answer, path or
+     no path
+   - if the start lies on a cached path to the same goal, with the rest of
+     that path from the start on; the rest of a shortest path is a
+     shortest path too
+
+   Anything else is searched for with astar_context_compute, and the result
+   cached, pushing out the least recently used one if the cache is full.
+
+   The cache can't tell when the grid changes, so every query comes with a
+   version number of the grid, which the caller must change whenever they
+   change the grid. A query with a different version from the last one
+   empties the cache first.
+
+   A cache is not safe to use from several threads at once.
+ */
+
+typedef struct astar_cache astar_cache_t;
+
+/* hits: queries answered with the path of the same query
+   suffixHits: queries answered with part of a path to the same goal
+   misses: queries that had to be searched for
+   evictions: paths pushed out to make room for new ones
+   flushes: times the cache was emptied because the grid version changed
+ */
+typedef struct astar_cache_stats {
+	long hits;
+	long suffixHits;
+	long misses;
+	long evictions;
+	long flushes;
+} astar_cache_stats_t;
+
+/* capacity: the most paths to keep
+
+   returns NULL if allocation fails, or the bounds or capacity are not
+   positive
+ */
+astar_cache_t *astar_cache_create (int boundX, int boundY, int capacity);
+
+void astar_cache_free (astar_cache_t *cache);
+
+/* astar_context_compute through the cache. The path returned is the
+   caller's to free, as always. */
+int *astar_cache_compute (astar_cache_t *cache,
+			  const char *grid,
+			  unsigned int version,
+			  int *solLength,
+			  int start,
+			  int end);
+
+const astar_cache_stats_t *astar_cache_stats (const astar_cache_t *cache);
+
+#endif
@@ -0,0 +1,384 @@
+#include "AStarDStar.h"
+#include "AStar.h"
+#include "IndexPriorityQueue.h"
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+
+// the same step costs as the flat searches
+#ifdef ASTAR_INTEGER_COSTS
+#define STRAIGHT_COST ASTAR_COST_STRAIGHT
+#define DIAGONAL_COST ASTAR_COST_DIAGONAL
+#define UNREACHABLE INT_MAX
+#define KEY_SLACK(key) 0
+#else
+#define STRAIGHT_COST 1.0
+#define DIAGONAL_COST 1.4142135623730951
+#define UNREACHABLE INFINITY
+// the same distance summed up along different paths can round differently,
+// so keys that should tie may not quite
+#define KEY_SLACK(key) ((key) * 1e-9)
+#endif
+
+/* g is the distance to the goal as of the last time the cell was expanded,
+   rhs the distance going by its neighbours' g as they are now. A cell
+   where they differ is inconsistent, and it's in the queue, keyed by
+   min (g, rhs) plus the estimate from the start, plus km. km makes up for
+   the start moving: instead of rekeying the whole queue, the estimate from
+   the old start to the new one is added to every key from then on, and
+   keys that turn out to be too low when they come up are fixed then.
+
+   D* Lite breaks ties between keys by min (g, rhs); with a single key we
+   carry on through the ties instead, which can expand a few cells more
+   than needed but never stops too early. */
+struct astar_dstar {
+	const char *grid;
+	int boundX;
+	int boundY;
+	int start;
+	int goal;
+	double km;
+	astar_cost_t *g;
+	astar_cost_t *rhs;
+	queue *open;
+	long expanded;
+	// set once the queue couldn't take a cell; there's no telling which
+	// distances are right after that
+	int outOfMemory;
+};
+
+// directions 0..7 are N, NE, E, SE, S, SW, W, NW, as in AStar.c
+static const int stepX[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int stepY[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+
+// cell indexes follow the layout of the build (see ASTAR_LAYOUT)
+#if ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+static inline int cellAt (int boundX, int x, int y)
+{
+	return y * boundX + x;
+}
+
+static inline void cellCoord (int boundX, int cell, int *x, int *y)
+{
+	*x = cell % boundX;
+	*y = cell / boundX;
+}
+#else
+static inline int cellAt (int boundX, int x, int y)
+{
+	return astar_getIndexByWidth (boundX, x, y);
+}
+
+static inline void cellCoord (int boundX, int cell, int *x, int *y)
+{
+	astar_getCoordByWidth (boundX, cell, x, y);
+}
+#endif
+
+// is cell a cell of the map, and not padding of the layout?
+static int onGrid (int boundX, int boundY, int cell)
+{
+	if (cell < 0 || cell >= astar_layout_size (boundX, boundY))
+		return 0;
+	int x, y;
+	cellCoord (boundX, cell, &x, &y);
+	return x < boundX && y < boundY;
+}
+
+static int isOpen (const astar_dstar_t *d, int x, int y)
+{
+	return d->grid[cellAt (d->boundX, x, y)];
+}
+
+static astar_cost_t stepCost (int dir)
+{
+	return dir & 1 ? DIAGONAL_COST : STRAIGHT_COST;
+}
+
+// can we step from (x, y) in direction dir?
+static int canStep (const astar_dstar_t *d, int x, int y, int dir)
+{
+	int dx = stepX[dir], dy = stepY[dir];
+	int nx = x + dx, ny = y + dy;
+	if (nx < 0 || ny < 0 || nx >= d->boundX || ny >= d->boundY || !isOpen (d, nx, ny))
+		return 0;
+	if (!dx || !dy)
+		return 1;
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+	return 0;
+#elif ASTAR_MOVEMENT == ASTAR_MOVE_NO_CORNER_CUTTING
+	return isOpen (d, x + dx, y) && isOpen (d, x, y + dy);
+#else
+	return 1;
+#endif
+}
+
+// never more than the cost of any path between the cells, and consistent
+static double estimate (const astar_dstar_t *d, int a, int b)
+{
+	int ax, ay, bx, by;
+	cellCoord (d->boundX, a, &ax, &ay);
+	cellCoord (d->boundX, b, &bx, &by);
+	int dx = abs (ax - bx);
+	int dy = abs (ay - by);
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+	return (double) STRAIGHT_COST * (dx + dy);
+#else
+	if (dx < dy)
+		return (double) DIAGONAL_COST * dx + (double) STRAIGHT_COST * (dy - dx);
+	else
+		return (double) DIAGONAL_COST * dy + (double) STRAIGHT_COST * (dx - dy);
+#endif
+}
+
+static double keyOf (const astar_dstar_t *d, int node)
+{
+	astar_cost_t m = d->g[node] < d->rhs[node] ? d->g[node] : d->rhs[node];
+	return (double) m + estimate (d, d->start, node) + d->km;
+}
+
+// the best distance to the goal through the neighbours
+static astar_cost_t lookAhead (const astar_dstar_t *d, int node)
+{
+	if (node == d->goal)
+		return 0;
+	// only the start may be left from a cell that can't be entered
+	if (!d->grid[node] && node != d->start)
+		return UNREACHABLE;
+
+	int x, y;
+	cellCoord (d->boundX, node, &x, &y);
+	astar_cost_t best = UNREACHABLE;
+	for (int dir = 0; dir < 8; dir++) {
+		if (!canStep (d, x, y, dir))
+			continue;
+		int next = cellAt (d->boundX, x + stepX[dir], y + stepY[dir]);
+		if (d->g[next] == UNREACHABLE)
+			continue;
+		astar_cost_t cost = d->g[next] + stepCost (dir);
+		if (cost < best)
+			best = cost;
+	}
+	return best;
+}
+
+static void updateCell (astar_dstar_t *d, int node)
+{
+	d->rhs[node] = lookAhead (d, node);
+	if (d->g[node] != d->rhs[node]) {
+		int failed;
+		if (exists (d->open, node))
+			failed = changePriority (d->open, node, keyOf (d, node));
+		else
+			failed = insert (d->open, node, keyOf (d, node));
+		if (failed)
+			d->outOfMemory = 1;
+	}
+	else if (exists (d->open, node))
+		delete (d->open, node);
+}
+
+// update the cells that can step into node, and so depend on its g
+static void updatePredecessors (astar_dstar_t *d, int node)
+{
+	int x, y;
+	cellCoord (d->boundX, node, &x, &y);
+	for (int dir = 0; dir < 8; dir++) {
+		int px = x - stepX[dir], py = y - stepY[dir];
+		if (px < 0 || py < 0 || px >= d->boundX || py >= d->boundY)
+			continue;
+		if (canStep (d, px, py, dir))
+			updateCell (d, cellAt (d->boundX, px, py));
+	}
+}
+
+static void computeShortestPath (astar_dstar_t *d)
+{
+	int start = d->start;
+	while (d->open->size && !d->outOfMemory) {
+		item *top = findMin (d->open);
+		int node = top->value;
+		double oldKey = top->priority;
+		double startKey = keyOf (d, start);
+		if (oldKey > startKey + KEY_SLACK (startKey) && d->g[start] == d->rhs[start])
+			break;
+
+		double newKey = keyOf (d, node);
+		if (oldKey < newKey) {
+			if (changePriority (d->open, node, newKey)) {
+				d->outOfMemory = 1;
+				return;
+			}
+			continue;
+		}
+
+		d->expanded++;
+		if (d->g[node] > d->rhs[node]) {
+			d->g[node] = d->rhs[node];
+			deleteMin (d->open);
+			updatePredecessors (d, node);
+		}
+		else {
+			d->g[node] = UNREACHABLE;
+			updateCell (d, node);
+			updatePredecessors (d, node);
+		}
+	}
+}
+
+astar_dstar_t *astar_dstar_create (const char *grid,
+				   int boundX,
+				   int boundY,
+				   int start,
+				   int goal)
+{
+	if (boundX <= 0 || boundY <= 0)
+		return NULL;
+	if (!onGrid (boundX, boundY, start) || !onGrid (boundX, boundY, goal))
+		return NULL;
+	int size = astar_layout_size (boundX, boundY);
+
+	astar_dstar_t *d = calloc (1, sizeof (astar_dstar_t));
+	if (!d)
+		return NULL;
+
+	d->grid = grid;
+	d->boundX = boundX;
+	d->boundY = boundY;
+	d->start = start;
+	d->goal = goal;
+	d->g = malloc (size * sizeof (astar_cost_t));
+	d->rhs = malloc (size * sizeof (astar_cost_t));
+	d->open = createQueueOfKind (QUEUE_BINARY_HEAP, size);
+	if (!d->g || !d->rhs || !d->open) {
+		astar_dstar_free (d);
+		return NULL;
+	}
+
+	for (int i = 0; i < size; i++)
+		d->g[i] = d->rhs[i] = UNREACHABLE;
+	d->rhs[goal] = 0;
+	if (insert (d->open, goal, keyOf (d, goal))) {
+		astar_dstar_free (d);
+		return NULL;
+	}
+	return d;
+}
+
+void astar_dstar_free (astar_dstar_t *dstar)
+{
+	if (!dstar)
+		return;
+
+	free (dstar->g);
+	free (dstar->rhs);
+	if (dstar->open)
+		freeQueue (dstar->open);
+	free (dstar);
+}
+
+void astar_dstar_changed (astar_dstar_t *dstar, const int *cells, int nCells)
+{
+	for (int i = 0; i < nCells; i++) {
+		int cell = cells[i];
+		if (!onGrid (dstar->boundX, dstar->boundY, cell))
+			continue;
+
+		// every step that the cell can change the cost of starts at it or
+		// at one of its neighbours, corner cutting included
+		int x, y;
+		cellCoord (dstar->boundX, cell, &x, &y);
+		updateCell (dstar, cell);
+		for (int dir = 0; dir < 8; dir++) {
+			int nx = x + stepX[dir], ny = y + stepY[dir];
+			if (nx >= 0 && ny >= 0 && nx < dstar->boundX && ny < dstar->boundY)
+				updateCell (dstar, cellAt (dstar->boundX, nx, ny));
+		}
+	}
+}
+
+int astar_dstar_move_start (astar_dstar_t *dstar, int start)
+{
+	if (!onGrid (dstar->boundX, dstar->boundY, start))
+		return -1;
+	if (start == dstar->start)
+		return 0;
+
+	int old = dstar->start;
+	dstar->km += estimate (dstar, old, start);
+	dstar->start = start;
+	// leaving a cell that can't be entered is only allowed from the start
+	if (!dstar->grid[old])
+		updateCell (dstar, old);
+	if (!dstar->grid[start])
+		updateCell (dstar, start);
+	return 0;
+}
+
+// the neighbour on the cheapest way to the goal from node, or -1
+static int downhill (const astar_dstar_t *d, int node)
+{
+	int x, y;
+	cellCoord (d->boundX, node, &x, &y);
+	int next = -1;
+	astar_cost_t best = UNREACHABLE;
+	for (int dir = 0; dir < 8; dir++) {
+		if (!canStep (d, x, y, dir))
+			continue;
+		int n = cellAt (d->boundX, x + stepX[dir], y + stepY[dir]);
+		if (d->g[n] == UNREACHABLE)
+			continue;
+		astar_cost_t cost = d->g[n] + stepCost (dir);
+		if (cost < best) {
+			best = cost;
+			next = n;
+		}
+	}
+	return next;
+}
+
+int *astar_dstar_compute (astar_dstar_t *dstar, int *solLength)
+{
+	*solLength = -1;
+	dstar->expanded = 0;
+	computeShortestPath (dstar);
+	if (dstar->outOfMemory) {
+		*solLength = ASTAR_ERROR_NO_MEMORY;
+		return NULL;
+	}
+
+	int start = dstar->start;
+	if (dstar->g[start] == UNREACHABLE)
+		return NULL;
+
+	// Each step downhill lowers g, so this ends at the goal, but don't
+	// trust that blindly.
+	int size = astar_layout_size (dstar->boundX, dstar->boundY);
+	int length = 0;
+	for (int node = start; node != dstar->goal; length++) {
+		node = downhill (dstar, node);
+		if (node < 0 || length >= size)
+			return NULL;
+	}
+
+	int *rv = malloc ((length + 1) * sizeof (int));
+	if (!rv) {
+		*solLength = ASTAR_ERROR_NO_MEMORY;
+		return NULL;
+	}
+
+	// paths run from the goal at 0 back to the start
+	int node = start;
+	for (int i = length; i > 0; i--) {
+		rv[i] = node;
+		node = downhill (dstar, node);
+	}
+	rv[0] = node;
+	*solLength = length;
+	return rv;
+}
+
+long astar_dstar_expanded (const astar_dstar_t *dstar)
+{
+	return dstar->expanded;
+}
@@ -0,0 +1,59 @@
+#ifndef ASTARDSTAR_H_
+#define ASTARDSTAR_H_
+
+/* Incremental path repair (D* Lite), for a unit that keeps heading for the
+   same goal while the map changes around it: doors opening and closing,
+   buildings going up.
+
+   The planner searches backwards from the goal and keeps, for every cell
+   it has seen, its distance to the goal and the queue of cells whose
+   distances are out of date. When cells change, only the cells whose
+   distances depended on them are put back on the queue, and the next query
+   carries on from there instead of starting over; after a small change
+   that's usually a tiny fraction of the work of a fresh search. The start
+   may move too, as the unit walks along its path, without throwing
+   anything away.
+
+   The paths are shortest paths under the same step costs and movement
+   rules (ASTAR_MOVEMENT) as astar_compute, though where there are several
+   of them it may pick a different one. It's a plain search over the cells,
+   without jump points, so a fresh plan costs more than astar_compute; it
+   pays off from the first repair on.
+
+   The planner keeps a pointer to the grid, which must stay alive for as
+   long as the planner is used. Change the grid, then tell the planner
+   which cells changed with astar_dstar_changed before the next query.
+   Memory use is a few words per map cell. A planner is not safe to use
+   from several threads at once.
+ */
+
+typedef struct astar_dstar astar_dstar_t;
+
+/* returns NULL if allocation fails, the bounds are not positive, or the
+   start or goal is off the grid */
+astar_dstar_t *astar_dstar_create (const char *grid,
+				   int boundX,
+				   int boundY,
+				   int start,
+				   int goal);
+
+void astar_dstar_free (astar_dstar_t *dstar);
+
+/* the cells in cells[0] to cells[nCells - 1] have changed in the grid */
+void astar_dstar_changed (astar_dstar_t *dstar, const int *cells, int nCells);
+
+/* plan from a new start from now on, usually the next cell along the last
+   path; returns -1 if the start is off the grid, 0 otherwise */
+int astar_dstar_move_start (astar_dstar_t *dstar, int start);
+
+/* Brings the plan up to date and returns a path from the current start to
+   the goal, in the same form as astar_compute, or NULL if there is no
+   path or allocation fails. If the queue of cells to update runs out of
+   memory, the plan can't be trusted any more, and this and every later
+   query give ASTAR_ERROR_NO_MEMORY; start over with a new planner. */
+int *astar_dstar_compute (astar_dstar_t *dstar, int *solLength);
+
+/* how many cells the last astar_dstar_compute expanded */
+long astar_dstar_expanded (const astar_dstar_t *dstar);
+
+#endif
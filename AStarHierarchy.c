@@ -0,0 +1,803 @@
+#include "AStarHierarchy.h"
+#include "AStar.h"
+#include "IndexPriorityQueue.h"
+#include <stdlib.h>
+#include <string.h>
+
+// the same step costs as the flat searches
+#ifdef ASTAR_INTEGER_COSTS
+#define STRAIGHT_COST ASTAR_COST_STRAIGHT
+#define DIAGONAL_COST ASTAR_COST_DIAGONAL
+#else
+#define STRAIGHT_COST 1.0
+#define DIAGONAL_COST 1.4142135623730951
+#endif
+
+// stretches of border at least this long get a transition at each end,
+// shorter ones a single one in the middle
+#define LONG_ENTRANCE 6
+
+typedef struct edge {
+	int to;
+	astar_cost_t cost;
+} edge;
+
+// A cell in the abstract graph: one end of a transition, or during a query
+// the start or goal. Free nodes have sector -1, and cell holds the next
+// free node.
+typedef struct abstractNode {
+	int cell;
+	int sector;
+	edge *edges;
+	int nEdges;
+	int edgesAllocated;
+} abstractNode;
+
+typedef struct sector {
+	int x0, y0, x1, y1;
+	int *nodes;
+	int nNodes;
+	int nodesAllocated;
+	int dirty;
+} sector;
+
+struct astar_hierarchy {
+	const char *grid;
+	int boundX;
+	int boundY;
+	int sectorSize;
+	int sectorsX;
+	int sectorsY;
+	sector *sectors;
+
+	abstractNode *nodes;
+	int nNodes;
+	int nodesAllocated;
+	int freeNode;
+
+	// sectors waiting to be rebuilt
+	int *dirty;
+	int nDirty;
+
+	// searches within a sector run on a copy of it, padded out to
+	// sectorSize squared with blocked cells; localSector is the sector
+	// that's in there now, or -1
+	char *local;
+	int localSector;
+	astar_context_t *ctx;
+};
+
+// cell indexes follow the layout of the build (see ASTAR_LAYOUT), in the
+// map and in the copy of a sector alike
+#if ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+static inline int cellAt (int width, int x, int y)
+{
+	return y * width + x;
+}
+
+static inline void cellCoord (int width, int cell, int *x, int *y)
+{
+	*x = cell % width;
+	*y = cell / width;
+}
+#else
+static inline int cellAt (int width, int x, int y)
+{
+	return astar_getIndexByWidth (width, x, y);
+}
+
+static inline void cellCoord (int width, int cell, int *x, int *y)
+{
+	astar_getCoordByWidth (width, cell, x, y);
+}
+#endif
+
+static int isOpen (const astar_hierarchy_t *h, int x, int y)
+{
+	return h->grid[cellAt (h->boundX, x, y)];
+}
+
+// can we step diagonally from (x, y) by dx, dy, both of them non-zero,
+// given that the cell we'd land on is enterable?
+static int canStepDiagonally (const astar_hierarchy_t *h, int x, int y, int dx, int dy)
+{
+#if ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT
+	(void) h; (void) x; (void) y; (void) dx; (void) dy;
+	return 0;
+#elif ASTAR_MOVEMENT == ASTAR_MOVE_NO_CORNER_CUTTING
+	return isOpen (h, x + dx, y) && isOpen (h, x, y + dy);
+#else
+	(void) h; (void) x; (void) y; (void) dx; (void) dy;
+	return 1;
+#endif
+}
+
+static int sectorOf (const astar_hierarchy_t *h, int cell)
+{
+	int x, y;
+	cellCoord (h->boundX, cell, &x, &y);
+	return (y / h->sectorSize) * h->sectorsX + x / h->sectorSize;
+}
+
+// octile distance between two cells, in step costs; never more than the
+// cost of any path between them, so it's a fine heuristic
+static astar_cost_t octile (const astar_hierarchy_t *h, int a, int b)
+{
+	int ax, ay, bx, by;
+	cellCoord (h->boundX, a, &ax, &ay);
+	cellCoord (h->boundX, b, &bx, &by);
+	int dx = abs (ax - bx);
+	int dy = abs (ay - by);
+	if (dx < dy)
+		return DIAGONAL_COST * dx + STRAIGHT_COST * (dy - dx);
+	else
+		return DIAGONAL_COST * dy + STRAIGHT_COST * (dx - dy);
+}
+
+
+// The abstract graph
+
+static int newNode (astar_hierarchy_t *h, int s, int cell)
+{
+	int n = h->freeNode;
+	if (n >= 0)
+		h->freeNode = h->nodes[n].cell;
+	else {
+		if (h->nNodes == h->nodesAllocated) {
+			int allocated = h->nodesAllocated ? h->nodesAllocated * 2 : 64;
+			abstractNode *nodes = realloc (h->nodes, allocated * sizeof (abstractNode));
+			if (!nodes)
+				return -1;
+			h->nodes = nodes;
+			h->nodesAllocated = allocated;
+		}
+		n = h->nNodes++;
+		h->nodes[n].edges = NULL;
+		h->nodes[n].edgesAllocated = 0;
+	}
+
+	sector *sec = &h->sectors[s];
+	if (sec->nNodes == sec->nodesAllocated) {
+		int allocated = sec->nodesAllocated ? sec->nodesAllocated * 2 : 8;
+		int *nodes = realloc (sec->nodes, allocated * sizeof (int));
+		if (!nodes) {
+			h->nodes[n].sector = -1;
+			h->nodes[n].cell = h->freeNode;
+			h->freeNode = n;
+			return -1;
+		}
+		sec->nodes = nodes;
+		sec->nodesAllocated = allocated;
+	}
+	sec->nodes[sec->nNodes++] = n;
+
+	h->nodes[n].cell = cell;
+	h->nodes[n].sector = s;
+	h->nodes[n].nEdges = 0;
+	return n;
+}
+
+// the node of a cell in sector s, or -1 if it has none
+static int findNode (const astar_hierarchy_t *h, int s, int cell)
+{
+	const sector *sec = &h->sectors[s];
+	for (int i = 0; i < sec->nNodes; i++)
+		if (h->nodes[sec->nodes[i]].cell == cell)
+			return sec->nodes[i];
+	return -1;
+}
+
+static int nodeFor (astar_hierarchy_t *h, int s, int cell)
+{
+	int n = findNode (h, s, cell);
+	return n >= 0 ? n : newNode (h, s, cell);
+}
+
+static int addEdge (astar_hierarchy_t *h, int from, int to, astar_cost_t cost)
+{
+	abstractNode *node = &h->nodes[from];
+	if (node->nEdges == node->edgesAllocated) {
+		int allocated = node->edgesAllocated ? node->edgesAllocated * 2 : 8;
+		edge *edges = realloc (node->edges, allocated * sizeof (edge));
+		if (!edges)
+			return 0;
+		node->edges = edges;
+		node->edgesAllocated = allocated;
+	}
+	node->edges[node->nEdges++] = (edge) {to, cost};
+	return 1;
+}
+
+static int link (astar_hierarchy_t *h, int a, int b, astar_cost_t cost)
+{
+	return addEdge (h, a, b, cost) && addEdge (h, b, a, cost);
+}
+
+// drop the edges from node n to nodes in sector s
+static void dropEdgesInto (astar_hierarchy_t *h, int n, int s)
+{
+	abstractNode *node = &h->nodes[n];
+	for (int i = 0; i < node->nEdges; )
+		if (h->nodes[node->edges[i].to].sector == s)
+			node->edges[i] = node->edges[--node->nEdges];
+		else
+			i++;
+}
+
+// drop the edges from node n to node m
+static void dropEdgesTo (astar_hierarchy_t *h, int n, int m)
+{
+	abstractNode *node = &h->nodes[n];
+	for (int i = 0; i < node->nEdges; )
+		if (node->edges[i].to == m)
+			node->edges[i] = node->edges[--node->nEdges];
+		else
+			i++;
+}
+
+static void removeNode (astar_hierarchy_t *h, int n)
+{
+	abstractNode *node = &h->nodes[n];
+	for (int i = 0; i < node->nEdges; i++)
+		dropEdgesTo (h, node->edges[i].to, n);
+	node->nEdges = 0;
+
+	sector *sec = &h->sectors[node->sector];
+	for (int i = 0; i < sec->nNodes; i++)
+		if (sec->nodes[i] == n) {
+			sec->nodes[i] = sec->nodes[--sec->nNodes];
+			break;
+		}
+
+	node->sector = -1;
+	node->cell = h->freeNode;
+	h->freeNode = n;
+}
+
+
+// Searching within a sector
+
+static int *localSearch (astar_hierarchy_t *h, int s, int from, int to,
+			 int *solLength)
+{
+	const sector *sec = &h->sectors[s];
+	int size = h->sectorSize;
+
+	if (h->localSector != s) {
+		memset (h->local, 0, astar_layout_size (size, size));
+#if ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+		for (int y = sec->y0; y < sec->y1; y++)
+			memcpy (h->local + (y - sec->y0) * size,
+				h->grid + y * h->boundX + sec->x0,
+				sec->x1 - sec->x0);
+#else
+		for (int y = sec->y0; y < sec->y1; y++)
+			for (int x = sec->x0; x < sec->x1; x++)
+				h->local[cellAt (size, x - sec->x0, y - sec->y0)] =
+					isOpen (h, x, y);
+#endif
+		h->localSector = s;
+	}
+
+	int fx, fy, tx, ty;
+	cellCoord (h->boundX, from, &fx, &fy);
+	cellCoord (h->boundX, to, &tx, &ty);
+	int localFrom = cellAt (size, fx - sec->x0, fy - sec->y0);
+	int localTo = cellAt (size, tx - sec->x0, ty - sec->y0);
+	return astar_context_compute (h->ctx, h->local, solLength, localFrom, localTo);
+}
+
+// the cost of a path returned by localSearch
+static astar_cost_t localPathCost (const astar_hierarchy_t *h, const int *path, int length)
+{
+	astar_cost_t cost = 0;
+	for (int i = 0; i < length; i++) {
+		int ax, ay, bx, by;
+		cellCoord (h->sectorSize, path[i], &ax, &ay);
+		cellCoord (h->sectorSize, path[i + 1], &bx, &by);
+		cost += ax != bx && ay != by ? DIAGONAL_COST : STRAIGHT_COST;
+	}
+	return cost;
+}
+
+// link nodes a and b if b can be reached from a within sector s
+static int linkLocally (astar_hierarchy_t *h, int s, int a, int b)
+{
+	int length;
+	int *path = localSearch (h, s, h->nodes[a].cell, h->nodes[b].cell, &length);
+	if (!path)
+		return 1;
+
+	astar_cost_t cost = localPathCost (h, path, length);
+	free (path);
+	return link (h, a, b, cost);
+}
+
+// link node n with every other node in its sector; if toNode is set, the
+// searches go towards n, otherwise from it
+static int linkWithSector (astar_hierarchy_t *h, int n, int toNode)
+{
+	int s = h->nodes[n].sector;
+	for (int i = 0; i < h->sectors[s].nNodes; i++) {
+		int other = h->sectors[s].nodes[i];
+		if (other == n)
+			continue;
+		if (!(toNode ? linkLocally (h, s, other, n) : linkLocally (h, s, n, other)))
+			return 0;
+	}
+	return 1;
+}
+
+
+// Building the hierarchy
+
+static int addTransition (astar_hierarchy_t *h, int s, int t,
+			  int ax, int ay, int bx, int by, astar_cost_t cost)
+{
+	int a = nodeFor (h, s, cellAt (h->boundX, ax, ay));
+	if (a < 0)
+		return 0;
+	int b = nodeFor (h, t, cellAt (h->boundX, bx, by));
+	if (b < 0)
+		return 0;
+	return link (h, a, b, cost);
+}
+
+// Place the transitions from sector s into its neighbour t, which is in
+// direction dx, dy. Across a corner there's only the one pair of cells to
+// look at. Across a side, (x, y) + i * (stepX, stepY) walks along our side
+// of the border, and (dx, dy) on from there is the cell facing it.
+static int findTransitions (astar_hierarchy_t *h, int s, int t, int dx, int dy)
+{
+	const sector *sec = &h->sectors[s];
+	int x = dx > 0 ? sec->x1 - 1 : sec->x0;
+	int y = dy > 0 ? sec->y1 - 1 : sec->y0;
+
+	if (dx && dy) {
+		if (isOpen (h, x, y) && isOpen (h, x + dx, y + dy) &&
+		    canStepDiagonally (h, x, y, dx, dy))
+			return addTransition (h, s, t, x, y, x + dx, y + dy, DIAGONAL_COST);
+		return 1;
+	}
+
+	int stepX = !dx, stepY = !dy;
+	int length = dx ? sec->y1 - sec->y0 : sec->x1 - sec->x0;
+	int runStart = -1;
+
+	for (int i = 0; i <= length; i++) {
+		int ax = x + i * stepX, ay = y + i * stepY;
+		int crossing = i < length &&
+			isOpen (h, ax, ay) && isOpen (h, ax + dx, ay + dy);
+
+		if (crossing && runStart < 0)
+			runStart = i;
+		if (!crossing && runStart >= 0) {
+			int ends[2] = {runStart, i - 1};
+			if (i - runStart < LONG_ENTRANCE)
+				ends[0] = ends[1] = (runStart + i - 1) / 2;
+			for (int e = 0; e < (ends[0] == ends[1] ? 1 : 2); e++) {
+				int ex = x + ends[e] * stepX, ey = y + ends[e] * stepY;
+				if (!addTransition (h, s, t, ex, ey, ex + dx, ey + dy,
+						    STRAIGHT_COST))
+					return 0;
+			}
+			runStart = -1;
+		}
+
+		// Moving diagonally across the border only matters where
+		// neither this position nor the next can be crossed straight;
+		// otherwise a straight crossing next to it does just as well.
+		// Without corner cutting that's never, since the two cells a
+		// diagonal crossing passes between would make a straight one.
+		int nx = ax + stepX, ny = ay + stepY;
+		if (ASTAR_MOVEMENT != ASTAR_MOVE_DIAGONAL ||
+		    crossing || i + 1 >= length ||
+		    (isOpen (h, nx, ny) && isOpen (h, nx + dx, ny + dy)))
+			continue;
+
+		if (isOpen (h, ax, ay) && isOpen (h, nx + dx, ny + dy) &&
+		    !addTransition (h, s, t, ax, ay, nx + dx, ny + dy, DIAGONAL_COST))
+			return 0;
+		if (isOpen (h, nx, ny) && isOpen (h, ax + dx, ay + dy) &&
+		    !addTransition (h, s, t, nx, ny, ax + dx, ay + dy, DIAGONAL_COST))
+			return 0;
+	}
+	return 1;
+}
+
+// link every two nodes of sector s that can reach each other within it,
+// after dropping the old links, and the nodes no transition uses any more
+static int linkSector (astar_hierarchy_t *h, int s)
+{
+	sector *sec = &h->sectors[s];
+	for (int i = 0; i < sec->nNodes; i++)
+		dropEdgesInto (h, sec->nodes[i], s);
+	for (int i = 0; i < sec->nNodes; )
+		if (!h->nodes[sec->nodes[i]].nEdges)
+			removeNode (h, sec->nodes[i]);
+		else
+			i++;
+
+	for (int i = 0; i < sec->nNodes; i++)
+		for (int j = i + 1; j < sec->nNodes; j++)
+			if (!linkLocally (h, s, sec->nodes[i], sec->nodes[j]))
+				return 0;
+	return 1;
+}
+
+// the neighbour of sector s in direction dx, dy, or -1 past the map edge
+static int neighbourSector (const astar_hierarchy_t *h, int s, int dx, int dy)
+{
+	int sx = s % h->sectorsX + dx, sy = s / h->sectorsX + dy;
+	if (sx < 0 || sy < 0 || sx >= h->sectorsX || sy >= h->sectorsY)
+		return -1;
+	return sy * h->sectorsX + sx;
+}
+
+// Rebuild the dirty sectors: the transitions on their borders change, so
+// the links inside them and inside their neighbours have to be redone,
+// but nothing further away does.
+static int rebuild (astar_hierarchy_t *h)
+{
+	if (!h->nDirty)
+		return 1;
+	h->localSector = -1;
+
+	for (int i = 0; i < h->nDirty; i++) {
+		int s = h->dirty[i];
+		for (int dy = -1; dy <= 1; dy++)
+			for (int dx = -1; dx <= 1; dx++) {
+				int t = neighbourSector (h, s, dx, dy);
+				if (t < 0 || t == s)
+					continue;
+				for (int j = 0; j < h->sectors[s].nNodes; j++)
+					dropEdgesInto (h, h->sectors[s].nodes[j], t);
+				for (int j = 0; j < h->sectors[t].nNodes; j++)
+					dropEdgesInto (h, h->sectors[t].nodes[j], s);
+			}
+	}
+
+	// the transitions between two dirty sectors are only placed once
+	for (int i = 0; i < h->nDirty; i++) {
+		int s = h->dirty[i];
+		for (int dy = -1; dy <= 1; dy++)
+			for (int dx = -1; dx <= 1; dx++) {
+				int t = neighbourSector (h, s, dx, dy);
+				if (t < 0 || t == s || (h->sectors[t].dirty && t < s))
+					continue;
+				if (!findTransitions (h, s, t, dx, dy))
+					return 0;
+			}
+	}
+
+	// the neighbours join the list, marked 2, to be relinked too
+	int nDirty = h->nDirty;
+	for (int i = 0; i < nDirty; i++) {
+		int s = h->dirty[i];
+		for (int dy = -1; dy <= 1; dy++)
+			for (int dx = -1; dx <= 1; dx++) {
+				int t = neighbourSector (h, s, dx, dy);
+				if (t >= 0 && !h->sectors[t].dirty) {
+					h->sectors[t].dirty = 2;
+					h->dirty[h->nDirty++] = t;
+				}
+			}
+	}
+
+	for (int i = 0; i < h->nDirty; i++) {
+		if (!linkSector (h, h->dirty[i]))
+			return 0;
+		h->sectors[h->dirty[i]].dirty = 0;
+	}
+	h->nDirty = 0;
+	return 1;
+}
+
+void astar_hierarchy_changed (astar_hierarchy_t *h, int x, int y)
+{
+	if (x < 0 || y < 0 || x >= h->boundX || y >= h->boundY)
+		return;
+
+	int s = sectorOf (h, cellAt (h->boundX, x, y));
+	if (h->localSector == s)
+		h->localSector = -1;
+	if (!h->sectors[s].dirty) {
+		h->sectors[s].dirty = 1;
+		h->dirty[h->nDirty++] = s;
+	}
+}
+
+astar_hierarchy_t *astar_hierarchy_create (const char *grid,
+					   int boundX,
+					   int boundY,
+					   int sectorSize)
+{
+	if (boundX <= 0 || boundY <= 0 || sectorSize <= 0)
+		return NULL;
+
+	astar_hierarchy_t *h = calloc (1, sizeof (astar_hierarchy_t));
+	if (!h)
+		return NULL;
+
+	h->grid = grid;
+	h->boundX = boundX;
+	h->boundY = boundY;
+	h->sectorSize = sectorSize;
+	h->sectorsX = (boundX + sectorSize - 1) / sectorSize;
+	h->sectorsY = (boundY + sectorSize - 1) / sectorSize;
+	h->freeNode = -1;
+	h->localSector = -1;
+
+	int nSectors = h->sectorsX * h->sectorsY;
+	h->sectors = calloc (nSectors, sizeof (sector));
+	h->dirty = malloc (nSectors * sizeof (int));
+	h->local = malloc (astar_layout_size (sectorSize, sectorSize));
+	h->ctx = astar_context_create (sectorSize, sectorSize);
+	if (!h->sectors || !h->dirty || !h->local || !h->ctx) {
+		astar_hierarchy_free (h);
+		return NULL;
+	}
+
+	for (int s = 0; s < nSectors; s++) {
+		sector *sec = &h->sectors[s];
+		sec->x0 = s % h->sectorsX * sectorSize;
+		sec->y0 = s / h->sectorsX * sectorSize;
+		sec->x1 = sec->x0 + sectorSize < boundX ? sec->x0 + sectorSize : boundX;
+		sec->y1 = sec->y0 + sectorSize < boundY ? sec->y0 + sectorSize : boundY;
+		sec->dirty = 1;
+		h->dirty[h->nDirty++] = s;
+	}
+
+	if (!rebuild (h)) {
+		astar_hierarchy_free (h);
+		return NULL;
+	}
+	return h;
+}
+
+void astar_hierarchy_free (astar_hierarchy_t *h)
+{
+	if (!h)
+		return;
+
+	for (int n = 0; n < h->nNodes; n++)
+		free (h->nodes[n].edges);
+	free (h->nodes);
+	if (h->sectors)
+		for (int s = 0; s < h->sectorsX * h->sectorsY; s++)
+			free (h->sectors[s].nodes);
+	free (h->sectors);
+	free (h->dirty);
+	free (h->local);
+	astar_context_free (h->ctx);
+	free (h);
+}
+
+
+// Queries
+
+// A* over the abstract graph; returns the nodes of the path from end back
+// to start, or NULL, with *length -1 if there's no path and
+// ASTAR_ERROR_NO_MEMORY if allocation failed
+static int *abstractSearch (astar_hierarchy_t *h, int start, int end, int *length)
+{
+	int n = h->nNodes;
+	int *rv = NULL;
+	*length = ASTAR_ERROR_NO_MEMORY;
+	astar_cost_t *gScores = malloc (n * sizeof (astar_cost_t));
+	int *cameFrom = malloc (n * sizeof (int));
+	char *closed = calloc (n, 1);
+	queue *open = createQueueOfKind (QUEUE_BINARY_HEAP, n);
+	if (!gScores || !cameFrom || !closed || !open)
+		goto done;
+
+	int endCell = h->nodes[end].cell;
+	gScores[start] = 0;
+	cameFrom[start] = -1;
+	if (insert (open, start, octile (h, h->nodes[start].cell, endCell)))
+		goto done;
+
+	while (open->size) {
+		int node = findMin (open)->value;
+		if (node == end)
+			break;
+
+		deleteMin (open);
+		closed[node] = 1;
+
+		for (int i = 0; i < h->nodes[node].nEdges; i++) {
+			edge e = h->nodes[node].edges[i];
+			if (closed[e.to])
+				continue;
+
+			astar_cost_t gScore = gScores[node] + e.cost;
+			if (!exists (open, e.to)) {
+				gScores[e.to] = gScore;
+				cameFrom[e.to] = node;
+				if (insert (open, e.to, gScore + octile (h, h->nodes[e.to].cell, endCell)))
+					goto done;
+			}
+			else if (gScore < gScores[e.to]) {
+				double newPri = priorityOf (open, e.to) - gScores[e.to] + gScore;
+				gScores[e.to] = gScore;
+				cameFrom[e.to] = node;
+				if (changePriority (open, e.to, newPri))
+					goto done;
+			}
+		}
+	}
+
+	if (!open->size) {
+		*length = -1;
+		goto done;
+	}
+
+	int count = 0;
+	for (int i = end; i >= 0; i = cameFrom[i])
+		count++;
+	rv = malloc (count * sizeof (int));
+	if (rv) {
+		int j = 0;
+		for (int i = end; i >= 0; i = cameFrom[i])
+			rv[j++] = i;
+		*length = count;
+	}
+
+done:
+	free (gScores);
+	free (cameFrom);
+	free (closed);
+	if (open)
+		freeQueue (open);
+	return rv;
+}
+
+// Fill in the cells of an abstract path, going from its end back to its
+// start. Adjacent nodes in different sectors are a step apart; within a
+// sector, the path between them is searched for again.
+static int *refine (astar_hierarchy_t *h, const int *nodes, int nNodes, int *solLength)
+{
+	int allocated = 64;
+	int length = 0;
+	int *rv = malloc (allocated * sizeof (int));
+	if (!rv)
+		return NULL;
+	rv[length++] = h->nodes[nodes[0]].cell;
+
+	for (int i = 0; i + 1 < nNodes; i++) {
+		const abstractNode *from = &h->nodes[nodes[i + 1]];
+		const abstractNode *to = &h->nodes[nodes[i]];
+		int *path = NULL;
+		int pathLength = 1;
+		if (from->sector == to->sector) {
+			path = localSearch (h, from->sector, from->cell, to->cell, &pathLength);
+			if (!path) {
+				free (rv);
+				return NULL;
+			}
+		}
+
+		if (length + pathLength > allocated) {
+			while (length + pathLength > allocated)
+				allocated *= 2;
+			int *grown = realloc (rv, allocated * sizeof (int));
+			if (!grown) {
+				free (path);
+				free (rv);
+				return NULL;
+			}
+			rv = grown;
+		}
+
+		if (!path)
+			rv[length++] = from->cell;
+		else {
+			// the local path runs from its end back to its start
+			// too, in sector coordinates; its end is already in
+			const sector *sec = &h->sectors[from->sector];
+			for (int j = 1; j <= pathLength; j++) {
+				int x, y;
+				cellCoord (h->sectorSize, path[j], &x, &y);
+				rv[length++] = cellAt (h->boundX, x + sec->x0, y + sec->y0);
+			}
+			free (path);
+		}
+	}
+
+	*solLength = length - 1;
+	return rv;
+}
+
+// the node of a cell for a query, joining it to the graph if it isn't in
+// it yet; toNode as for linkWithSector
+static int queryNode (astar_hierarchy_t *h, int cell, int toNode,
+		      int *added, int *nAdded)
+{
+	int s = sectorOf (h, cell);
+	int n = findNode (h, s, cell);
+	if (n >= 0)
+		return n;
+
+	n = newNode (h, s, cell);
+	if (n < 0)
+		return -1;
+	added[(*nAdded)++] = n;
+	return linkWithSector (h, n, toNode) ? n : -1;
+}
+
+int *astar_hierarchy_compute (astar_hierarchy_t *h,
+			      int *solLength,
+			      int start,
+			      int end)
+{
+	*solLength = -1;
+	int size = astar_layout_size (h->boundX, h->boundY);
+	if (start >= size || start < 0 || end >= size || end < 0)
+		return NULL;
+	int sx, sy, ex, ey;
+	cellCoord (h->boundX, start, &sx, &sy);
+	cellCoord (h->boundX, end, &ex, &ey);
+	if (sx >= h->boundX || sy >= h->boundY || ex >= h->boundX || ey >= h->boundY)
+		return NULL;
+
+	// from here on, every way of failing but there being no path is
+	// running out of memory
+	*solLength = ASTAR_ERROR_NO_MEMORY;
+	if (!rebuild (h))
+		return NULL;
+
+	if (start == end) {
+		int *rv = malloc (sizeof (int));
+		if (rv) {
+			rv[0] = start;
+			*solLength = 0;
+		}
+		return rv;
+	}
+
+	// The start and goal join the graph for the duration of the query,
+	// unless they're in it already. The searches expand the start even
+	// if it's blocked, so a blocked start's first step may well leave its
+	// sector, and its neighbours in other sectors join the graph too.
+	int *rv = NULL;
+	int added[10];
+	int nAdded = 0;
+	int startNode = queryNode (h, start, 0, added, &nAdded);
+	if (startNode < 0)
+		goto done;
+
+	for (int dy = -1; dy <= 1 && !h->grid[start]; dy++)
+		for (int dx = -1; dx <= 1; dx++) {
+			int x = sx + dx, y = sy + dy;
+			if (x < 0 || y < 0 || x >= h->boundX || y >= h->boundY ||
+			    !isOpen (h, x, y) ||
+			    (dx && dy && !canStepDiagonally (h, sx, sy, dx, dy)))
+				continue;
+
+			int cell = cellAt (h->boundX, x, y);
+			if (sectorOf (h, cell) == sectorOf (h, start))
+				continue;
+
+			int n = queryNode (h, cell, 0, added, &nAdded);
+			if (n < 0 || !link (h, startNode, n, dx && dy ? DIAGONAL_COST : STRAIGHT_COST))
+				goto done;
+		}
+
+	int endNode = queryNode (h, end, 1, added, &nAdded);
+	if (endNode < 0)
+		goto done;
+
+	int nNodes;
+	int *nodes = abstractSearch (h, startNode, endNode, &nNodes);
+	if (nodes) {
+		rv = refine (h, nodes, nNodes, solLength);
+		free (nodes);
+	}
+	else
+		*solLength = nNodes;
+
+done:
+	while (nAdded)
+		removeNode (h, added[--nAdded]);
+	return rv;
+}
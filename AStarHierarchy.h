@@ -0,0 +1,58 @@
+#ifndef ASTARHIERARCHY_H_
+#define ASTARHIERARCHY_H_
+
+/* Hierarchical pathfinding (HPA*), for maps so big that even jump point
+   search expands too much on queries across them, and the per-cell arrays
+   of a full-map search context get expensive.
+
+   The grid is cut into square sectors. Wherever two neighbouring sectors
+   have enterable cells next to each other across their border, a
+   transition is placed: one for a short stretch of such cells, or one at
+   each end of a long one. The cells of the transitions make up an abstract
+   graph, with edges across the borders and, within each sector, between
+   every two of its transition cells that can reach each other, at the cost
+   of the shortest path between them inside the sector. Those costs are
+   found ahead of time with astar_compute on the sector alone.
+
+   A query adds the start and goal to the graph, searches it, and then only
+   searches within the sectors the abstract path goes through to fill in
+   the cells. All the per-query memory is per abstract node or per sector,
+   never per map cell. The paths found are always valid, and whenever
+   astar_compute finds a path this does too, but they may be a little
+   longer than astar_compute's, since they're restricted to go through the
+   transition cells.
+
+   The hierarchy keeps a pointer to the grid, which must stay alive for as
+   long as the hierarchy is used. When cells change, tell it with
+   astar_hierarchy_changed; the sectors around them are rebuilt at the next
+   query, and the rest of the hierarchy is left as it was. Queries modify
+   the hierarchy, so it is not safe to use from several threads at once.
+ */
+
+typedef struct astar_hierarchy astar_hierarchy_t;
+
+/* sectorSize: the width and height of a sector in cells. Bigger sectors
+   make for fewer abstract nodes, but more work per sector, both when
+   building and when filling in paths; 32 is a good place to start.
+
+   returns NULL if allocation fails or the bounds or sector size are not
+   positive
+ */
+astar_hierarchy_t *astar_hierarchy_create (const char *grid,
+					   int boundX,
+					   int boundY,
+					   int sectorSize);
+
+void astar_hierarchy_free (astar_hierarchy_t *hierarchy);
+
+/* the cell at x, y has changed in the grid */
+void astar_hierarchy_changed (astar_hierarchy_t *hierarchy, int x, int y);
+
+/* returns a path in the same form as astar_compute, or NULL if there is no
+   path or allocation fails, with solLength -1 or ASTAR_ERROR_NO_MEMORY */
+int *astar_hierarchy_compute (astar_hierarchy_t *hierarchy,
+			      int *solLength,
+			      int start,
+			      int end);
+
+#endif
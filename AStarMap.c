@@ -0,0 +1,288 @@
+#define _POSIX_C_SOURCE 200112L
+#include "AStarMap.h"
+#include "AStar.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAGIC "ASTARMAP"
+#define BYTE_ORDER_MARK 0x01020304
+#define VERSION 1
+#define FLAG_PACKED 1
+
+// the grid and every section start on a boundary of this many bytes
+#define ALIGNMENT 64
+
+typedef struct fileHeader {
+	char magic[8];
+	uint32_t byteOrder;
+	uint32_t version;
+	uint32_t flags;
+	int32_t boundX;
+	int32_t boundY;
+	uint32_t nSections;
+	uint64_t gridOffset;
+	uint64_t gridSize;
+} fileHeader;
+
+// the section table comes right after the header
+typedef struct sectionEntry {
+	uint32_t tag;
+	uint32_t reserved;
+	uint64_t offset;
+	uint64_t size;
+} sectionEntry;
+
+struct astar_map {
+	void *mapping;
+	size_t mappingSize;
+	const fileHeader *header;
+	const sectionEntry *sections;
+	const char *grid;
+	char *unpacked;
+};
+
+static uint64_t align (uint64_t offset)
+{
+	return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+// bytes per row of a packed grid
+static uint64_t packedRowSize (int boundX)
+{
+	return (boundX + 7) / 8;
+}
+
+static int writePadding (FILE *f, uint64_t to)
+{
+	static const char zeroes[ALIGNMENT];
+	long at = ftell (f);
+	return at >= 0 && fwrite (zeroes, 1, to - at, f) == to - at;
+}
+
+int astar_map_write (const char *path,
+		     const char *grid,
+		     int boundX,
+		     int boundY,
+		     int packed,
+		     const astar_map_section_t *sections,
+		     int nSections)
+{
+	if (boundX <= 0 || boundY <= 0 || nSections < 0)
+		return -1;
+
+	fileHeader header;
+	memcpy (header.magic, MAGIC, sizeof (header.magic));
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.version = VERSION;
+	header.flags = packed ? FLAG_PACKED : 0;
+	header.boundX = boundX;
+	header.boundY = boundY;
+	header.nSections = nSections;
+	header.gridOffset = align (sizeof (fileHeader) + nSections * sizeof (sectionEntry));
+	header.gridSize = packed ? packedRowSize (boundX) * boundY : (uint64_t) boundX * boundY;
+
+	sectionEntry *table = calloc (nSections ? nSections : 1, sizeof (sectionEntry));
+	unsigned char *row = malloc (packed ? packedRowSize (boundX) : (uint64_t) boundX);
+	FILE *f = fopen (path, "wb");
+	int ok = table && row && f;
+
+	uint64_t offset = align (header.gridOffset + header.gridSize);
+	for (int i = 0; ok && i < nSections; i++) {
+		table[i].tag = sections[i].tag;
+		table[i].offset = offset;
+		table[i].size = sections[i].size;
+		offset = align (offset + sections[i].size);
+	}
+
+	ok = ok && fwrite (&header, sizeof (header), 1, f) == 1 &&
+		fwrite (table, sizeof (sectionEntry), nSections, f) == (size_t) nSections &&
+		writePadding (f, header.gridOffset);
+
+	// the grid a row at a time, whatever the layout in memory, with every
+	// enterable cell as a 1
+	for (int y = 0; ok && y < boundY; y++) {
+		if (packed) {
+			memset (row, 0, packedRowSize (boundX));
+			for (int x = 0; x < boundX; x++)
+				if (grid[astar_getIndexByWidth (boundX, x, y)])
+					row[x / 8] |= 1 << (x % 8);
+			ok = fwrite (row, packedRowSize (boundX), 1, f) == 1;
+		}
+		else {
+			for (int x = 0; x < boundX; x++)
+				row[x] = grid[astar_getIndexByWidth (boundX, x, y)] != 0;
+			ok = fwrite (row, boundX, 1, f) == 1;
+		}
+	}
+
+	for (int i = 0; ok && i < nSections; i++)
+		ok = writePadding (f, table[i].offset) &&
+			fwrite (sections[i].data, 1, sections[i].size, f) == sections[i].size;
+
+	if (f && fclose (f))
+		ok = 0;
+	free (row);
+	free (table);
+	return ok ? 0 : -1;
+}
+
+// is the file we mapped really a map file, with everything within it?
+static int validate (const astar_map_t *map)
+{
+	const fileHeader *header = map->header;
+	if (map->mappingSize < sizeof (fileHeader) ||
+	    memcmp (header->magic, MAGIC, sizeof (header->magic)) ||
+	    header->byteOrder != BYTE_ORDER_MARK ||
+	    header->version != VERSION ||
+	    header->boundX <= 0 || header->boundY <= 0)
+		return 0;
+
+	uint64_t size = map->mappingSize;
+	uint64_t gridSize = header->flags & FLAG_PACKED ?
+		packedRowSize (header->boundX) * header->boundY :
+		(uint64_t) header->boundX * header->boundY;
+	if (header->nSections > (size - sizeof (fileHeader)) / sizeof (sectionEntry) ||
+	    header->gridSize != gridSize ||
+	    header->gridOffset > size || gridSize > size - header->gridOffset)
+		return 0;
+
+	for (uint32_t i = 0; i < header->nSections; i++)
+		if (map->sections[i].offset > size ||
+		    map->sections[i].size > size - map->sections[i].offset)
+			return 0;
+	return 1;
+}
+
+astar_map_t *astar_map_open (const char *path)
+{
+	int fd = open (path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	astar_map_t *map = calloc (1, sizeof (astar_map_t));
+	if (!map || fstat (fd, &st) || st.st_size <= 0) {
+		free (map);
+		close (fd);
+		return NULL;
+	}
+
+	map->mappingSize = st.st_size;
+	map->mapping = mmap (NULL, map->mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (map->mapping == MAP_FAILED) {
+		free (map);
+		return NULL;
+	}
+
+	map->header = map->mapping;
+	map->sections = (const sectionEntry *) (map->header + 1);
+	if (!validate (map)) {
+		astar_map_close (map);
+		return NULL;
+	}
+
+	const fileHeader *header = map->header;
+	const unsigned char *grid = (const unsigned char *) map->mapping + header->gridOffset;
+	int packed = header->flags & FLAG_PACKED;
+	if (!packed && ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR) {
+		map->grid = (const char *) grid;
+		return map;
+	}
+
+	// the file is row-major, so other layouts get a copy too
+	int width = header->boundX;
+	map->unpacked = calloc (astar_layout_size (width, header->boundY), 1);
+	if (!map->unpacked) {
+		astar_map_close (map);
+		return NULL;
+	}
+	for (int y = 0; y < header->boundY; y++) {
+		const unsigned char *row = grid + y * (packed ? packedRowSize (width) : (uint64_t) width);
+		for (int x = 0; x < width; x++)
+			map->unpacked[astar_getIndexByWidth (width, x, y)] = 
+				packed ? (row[x / 8] >> (x % 8)) & 1 : row[x];
+	}
+	map->grid = map->unpacked;
+	return map;
+}
+
+void astar_map_close (astar_map_t *map)
+{
+	if (!map)
+		return;
+
+	munmap (map->mapping, map->mappingSize);
+	free (map->unpacked);
+	free (map);
+}
+
+const char *astar_map_grid (const astar_map_t *map)
+{
+	return map->grid;
+}
+
+int astar_map_width (const astar_map_t *map)
+{
+	return map->header->boundX;
+}
+
+int astar_map_height (const astar_map_t *map)
+{
+	return map->header->boundY;
+}
+
+const void *astar_map_section (const astar_map_t *map, uint32_t tag, size_t *size)
+{
+	for (uint32_t i = 0; i < map->header->nSections; i++)
+		if (map->sections[i].tag == tag) {
+			*size = map->sections[i].size;
+			return (const char *) map->mapping + map->sections[i].offset;
+		}
+	return NULL;
+}
+
+char *astar_map_read_movingai (const char *path, int *boundX, int *boundY)
+{
+	FILE *f = fopen (path, "r");
+	if (!f)
+		return NULL;
+
+	int width, height;
+	if (fscanf (f, "type octile\nheight %i\nwidth %i\nmap\n", &height, &width) != 2 ||
+	    width <= 0 || height <= 0) {
+		fclose (f);
+		return NULL;
+	}
+
+	// zeroed, for the padding round a tiled grid
+	char *grid = calloc (astar_layout_size (width, height), 1);
+	char *buf = malloc (width + 3); // space for \r\n and the terminator
+	if (!grid || !buf) {
+		free (grid);
+		free (buf);
+		fclose (f);
+		return NULL;
+	}
+
+	for (int y = 0; y < height; y++) {
+		if (!fgets (buf, width + 3, f) || (int) strlen (buf) < width) {
+			free (grid);
+			grid = NULL;
+			break;
+		}
+		for (int x = 0; x < width; x++)
+			grid[astar_getIndexByWidth (width, x, y)] = buf[x] == '.' || buf[x] == 'G';
+	}
+
+	free (buf);
+	fclose (f);
+	*boundX = width;
+	*boundY = height;
+	return grid;
+}
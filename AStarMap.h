@@ -0,0 +1,81 @@
+#ifndef ASTARMAP_H_
+#define ASTARMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A binary map file format that can be memory-mapped, so that loading a
+   map costs next to nothing and processes on the same machine share one
+   copy of it through the page cache.
+
+   A file holds a header, the grid, and any number of extra sections, such
+   as precomputed JPS+ tables, each tagged with four characters. The grid
+   is stored either a byte per cell, in which case astar_map_grid points
+   straight into the mapping and the grid is never copied, or packed a bit
+   per cell, which is an eighth of the size but gets unpacked into memory
+   when the file is opened. The grid is stored row-major whatever
+   ASTAR_LAYOUT is, so a build with a tiled layout copies it into that
+   when the file is opened too. Everything is stored in the byte order of
+   the machine that wrote the file; files in the other byte order are
+   refused.
+
+   A map file is only read once it's open, so several threads can share
+   one.
+ */
+
+#define ASTAR_MAP_TAG(a, b, c, d) \
+	((uint32_t) (a) | (uint32_t) (b) << 8 | (uint32_t) (c) << 16 | (uint32_t) (d) << 24)
+
+/* JPS+ tables, as returned by astar_jpsplus_tables */
+#define ASTAR_MAP_SECTION_JPSPLUS ASTAR_MAP_TAG ('J', 'P', 'S', '+')
+
+/* landmark tables, as returned by astar_landmarks_tables */
+#define ASTAR_MAP_SECTION_LANDMARKS ASTAR_MAP_TAG ('L', 'M', 'R', 'K')
+
+typedef struct astar_map_section {
+	uint32_t tag;
+	const void *data;
+	size_t size;
+} astar_map_section_t;
+
+typedef struct astar_map astar_map_t;
+
+/* Write a map file, from a grid in the layout of the build. packed: store
+   the grid a bit per cell.
+
+   return value: 0 on success, -1 if the file couldn't be written
+ */
+int astar_map_write (const char *path,
+		     const char *grid,
+		     int boundX,
+		     int boundY,
+		     int packed,
+		     const astar_map_section_t *sections,
+		     int nSections);
+
+/* returns NULL if the file can't be opened or isn't a valid map file */
+astar_map_t *astar_map_open (const char *path);
+
+void astar_map_close (astar_map_t *map);
+
+/* The grid, ready to pass to astar_compute; it stays valid until the map is
+   closed. */
+const char *astar_map_grid (const astar_map_t *map);
+
+int astar_map_width (const astar_map_t *map);
+
+int astar_map_height (const astar_map_t *map);
+
+/* the section with the given tag and its size in bytes, or NULL if the file
+   has none; sections start on 64-byte boundaries */
+const void *astar_map_section (const astar_map_t *map, uint32_t tag, size_t *size);
+
+/* Read a map in the ASCII format of http://movingai.com/benchmarks/ into a
+   newly allocated grid, which the caller must free. '.' and 'G' are
+   enterable, everything else is not.
+
+   returns NULL if the file can't be read or isn't in that format
+ */
+char *astar_map_read_movingai (const char *path, int *boundX, int *boundY);
+
+#endif
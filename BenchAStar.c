@@ -0,0 +1,606 @@
+#define _POSIX_C_SOURCE 200809L
+#include "AStar.h"
+#include "AStarHierarchy.h"
+#include "AStarMap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* Runs whole directories of scenario files from
+   http://movingai.com/benchmarks/ (or the older format TestAStar reads) and
+   reports per-bucket latency and throughput for each search algorithm. */
+
+// the sector size of the hierarchy algorithm
+#define SECTOR_SIZE 32
+
+// the weight of the weighted algorithm
+#define WEIGHT 1.2
+
+// the number of landmarks of the landmarks algorithm
+#define LANDMARKS 8
+
+typedef struct map {
+	char *name;
+	int width;
+	int height;
+	char *grid;
+	astar_context_t *ctx;
+	astar_context_t *backCtx;
+	astar_context_t *openListCtx[ASTAR_OPEN_BUCKET_QUEUE + 1];
+	astar_context_t *weightedCtx;
+	astar_context_t *landmarkCtx;
+	astar_landmarks_t *landmarks;
+	astar_jpsplus_t *jpsplus;
+	astar_bitgrid_t *bitgrid;
+	astar_neighbours_t *neighbours;
+	astar_components_t *components;
+	astar_hierarchy_t *hierarchy;
+	struct map *next;
+} map;
+
+typedef struct scenario {
+	map *map;
+	int bucket;
+	int start;
+	int end;
+} scenario;
+
+typedef int *(*search_fn) (map *m, int *solLength, int start, int end);
+
+static int *runCompute (map *m, int *solLength, int start, int end)
+{
+	return astar_compute (m->grid, solLength, m->width, m->height, start, end);
+}
+
+static int *runUnopt (map *m, int *solLength, int start, int end)
+{
+	return astar_unopt_compute (m->grid, solLength, m->width, m->height, start, end);
+}
+
+static int *runContext (map *m, int *solLength, int start, int end)
+{
+	return astar_context_compute (m->ctx, m->grid, solLength, start, end);
+}
+
+// a context with the given open list, made on first use
+static int *runWithOpenList (map *m, astar_open_list_t openList, 
+			     int *solLength, int start, int end)
+{
+	if (!m->openListCtx[openList]) {
+		m->openListCtx[openList] = 
+			astar_context_create_with_open_list (m->width, m->height, openList);
+		if (!m->openListCtx[openList]) {
+			fprintf (stderr, "out of memory\n");
+			exit (1);
+		}
+	}
+	return astar_context_compute (m->openListCtx[openList], m->grid, solLength, start, end);
+}
+
+static int *runBinaryHeap (map *m, int *solLength, int start, int end)
+{
+	return runWithOpenList (m, ASTAR_OPEN_BINARY_HEAP, solLength, start, end);
+}
+
+static int *runRadixHeap (map *m, int *solLength, int start, int end)
+{
+	return runWithOpenList (m, ASTAR_OPEN_RADIX_HEAP, solLength, start, end);
+}
+
+static int *runBucketQueue (map *m, int *solLength, int start, int end)
+{
+	return runWithOpenList (m, ASTAR_OPEN_BUCKET_QUEUE, solLength, start, end);
+}
+
+static int *runBidir (map *m, int *solLength, int start, int end)
+{
+	return astar_context_compute_bidir (m->ctx, m->backCtx, m->grid, solLength, start, end);
+}
+
+// a context with a weight, made on first use
+static int *runWeighted (map *m, int *solLength, int start, int end)
+{
+	if (!m->weightedCtx) {
+		m->weightedCtx = astar_context_create (m->width, m->height);
+		if (!m->weightedCtx || !astar_context_set_weight (m->weightedCtx, WEIGHT)) {
+			fprintf (stderr, "out of memory\n");
+			exit (1);
+		}
+	}
+	return astar_context_compute (m->weightedCtx, m->grid, solLength, start, end);
+}
+
+// landmarks and a context to attach them to, made on first use
+static int *runLandmarks (map *m, int *solLength, int start, int end)
+{
+	if (!m->landmarkCtx) {
+		m->landmarks = astar_landmarks_create (m->grid, m->width, m->height, LANDMARKS, 0);
+		m->landmarkCtx = astar_context_create (m->width, m->height);
+		if (!m->landmarks || !m->landmarkCtx || 
+		    !astar_context_set_landmarks (m->landmarkCtx, m->landmarks)) {
+			fprintf (stderr, "out of memory\n");
+			exit (1);
+		}
+	}
+	return astar_context_compute (m->landmarkCtx, m->grid, solLength, start, end);
+}
+
+// JPS+, the bit grid and the masks only exist for the default movement
+// and layout
+#if ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL && ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+static int *runJpsPlus (map *m, int *solLength, int start, int end)
+{
+	return astar_context_compute_jpsplus (m->ctx, m->jpsplus, solLength, start, end);
+}
+
+static int *runBitgrid (map *m, int *solLength, int start, int end)
+{
+	return astar_context_compute_bitgrid (m->ctx, m->bitgrid, solLength, start, end);
+}
+
+static int *runNeighbours (map *m, int *solLength, int start, int end)
+{
+	return astar_context_compute_neighbours (m->ctx, m->neighbours, solLength, start, end);
+}
+#endif
+
+static int *runComponents (map *m, int *solLength, int start, int end)
+{
+	return astar_compute_components (m->components, m->grid, solLength, start, end);
+}
+
+static int *runHierarchy (map *m, int *solLength, int start, int end)
+{
+	return astar_hierarchy_compute (m->hierarchy, solLength, start, end);
+}
+
+// optimal: whether the algorithm always finds the shortest paths, so its
+// path lengths can be checked against the others'
+static const struct {
+	const char *name;
+	search_fn run;
+	int optimal;
+} algorithms[] = {
+	{"jps", runCompute, 1},
+	{"unopt", runUnopt, 1},
+	{"context", runContext, 1},
+	{"bidir", runBidir, 1},
+#if ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL && ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+	{"jpsplus", runJpsPlus, 1},
+	{"bitgrid", runBitgrid, 1},
+	{"neighbours", runNeighbours, 1},
+#endif
+	{"components", runComponents, 1},
+	{"binaryheap", runBinaryHeap, 1},
+	{"radixheap", runRadixHeap, 1},
+	{"bucketqueue", runBucketQueue, 1},
+	{"hierarchy", runHierarchy, 0},
+	{"weighted", runWeighted, 0},
+	{"landmarks", runLandmarks, 1},
+};
+#define N_ALGORITHMS (int) (sizeof (algorithms) / sizeof (algorithms[0]))
+
+// the latencies measured for one algorithm in one bucket
+typedef struct samples {
+	double *times;
+	int count;
+	int allocated;
+} samples;
+
+static void addSample (samples *s, double t)
+{
+	if (s->count == s->allocated) {
+		s->allocated = s->allocated ? s->allocated * 2 : 64;
+		s->times = realloc (s->times, s->allocated * sizeof (double));
+		if (!s->times) {
+			fprintf (stderr, "out of memory\n");
+			exit (1);
+		}
+	}
+	s->times[s->count++] = t;
+}
+
+static int compareDoubles (const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static double now (void)
+{
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static map *maps = NULL;
+static const char *mapDir = NULL;
+
+static int readable (const char *path)
+{
+	FILE *f = fopen (path, "r");
+	if (f)
+		fclose (f);
+	return f != NULL;
+}
+
+// where the map file is, written to path; 0 if it can't be found
+static int findMapFile (const char *name, const char *scenPath, char *path, size_t size)
+{
+	int len = snprintf (path, size, "%s", name);
+	if (len < (int) size && readable (path))
+		return 1;
+
+	// relative to the scenario file
+	const char *slash = strrchr (scenPath, '/');
+	if (slash) {
+		len = snprintf (path, size, "%.*s/%s",
+				(int) (slash - scenPath), scenPath, name);
+		if (len < (int) size && readable (path))
+			return 1;
+	}
+
+	// in the map directory, with or without the scenario's subdirectories
+	if (mapDir) {
+		len = snprintf (path, size, "%s/%s", mapDir, name);
+		if (len < (int) size && readable (path))
+			return 1;
+		const char *base = strrchr (name, '/');
+		len = snprintf (path, size, "%s/%s", mapDir, base ? base + 1 : name);
+		if (len < (int) size && readable (path))
+			return 1;
+	}
+	return 0;
+}
+
+static map *loadMap (const char *name, const char *scenPath)
+{
+	for (map *m = maps; m; m = m->next)
+		if (!strcmp (m->name, name))
+			return m;
+
+	char path[4096];
+	if (!findMapFile (name, scenPath, path, sizeof (path))) {
+		fprintf (stderr, "couldn't open map file %s: %s\n",
+			 name, strerror (errno));
+		exit (1);
+	}
+
+	map *m = calloc (1, sizeof (map));
+	if (!m || !(m->name = strdup (name))) {
+		fprintf (stderr, "out of memory\n");
+		exit (1);
+	}
+	// in the layout of the build, with the padding of a tiled one blocked
+	m->grid = astar_map_read_movingai (path, &m->width, &m->height);
+	if (!m->grid) {
+		fprintf (stderr, "couldn't read map file %s\n", name);
+		exit (1);
+	}
+
+	m->ctx = astar_context_create (m->width, m->height);
+	m->backCtx = astar_context_create (m->width, m->height);
+	m->components = astar_components_create (m->grid, m->width, m->height);
+	m->hierarchy = astar_hierarchy_create (m->grid, m->width, m->height, SECTOR_SIZE);
+	if (!m->ctx || !m->backCtx || !m->components || !m->hierarchy) {
+		fprintf (stderr, "out of memory\n");
+		exit (1);
+	}
+#if ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL && ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+	m->jpsplus = astar_jpsplus_create (m->grid, m->width, m->height);
+	m->bitgrid = astar_bitgrid_create (m->grid, m->width, m->height);
+	m->neighbours = astar_neighbours_create (m->grid, m->width, m->height);
+	if (!m->jpsplus || !m->bitgrid || !m->neighbours) {
+		fprintf (stderr, "out of memory\n");
+		exit (1);
+	}
+#endif
+
+	m->next = maps;
+	maps = m;
+	return m;
+}
+
+static void freeMaps (void)
+{
+	while (maps) {
+		map *next = maps->next;
+		astar_context_free (maps->ctx);
+		astar_context_free (maps->backCtx);
+		for (int i = 0; i <= ASTAR_OPEN_BUCKET_QUEUE; i++)
+			astar_context_free (maps->openListCtx[i]);
+		astar_context_free (maps->weightedCtx);
+		astar_context_free (maps->landmarkCtx);
+		astar_landmarks_free (maps->landmarks);
+		astar_jpsplus_free (maps->jpsplus);
+		astar_bitgrid_free (maps->bitgrid);
+		astar_neighbours_free (maps->neighbours);
+		astar_components_free (maps->components);
+		astar_hierarchy_free (maps->hierarchy);
+		free (maps->grid);
+		free (maps->name);
+		free (maps);
+		maps = next;
+	}
+}
+
+static scenario *scenarios = NULL;
+static int nScenarios = 0;
+static int scenariosAllocated = 0;
+
+// accepts both the MovingAI format (9 columns, the optimal length as a
+// real number) and the older one TestAStar reads (10 columns)
+static void loadScenarios (const char *path)
+{
+	FILE *scenFile = fopen (path, "r");
+	if (!scenFile) {
+		fprintf (stderr, "couldn't open scenario file %s: %s\n",
+			 path, strerror (errno));
+		exit (1);
+	}
+
+	char line[4096];
+	char mapName[4096];
+	while (fgets (line, sizeof (line), scenFile)) {
+		int bucket, width, height, startX, startY, goalX, goalY;
+		if (sscanf (line, "%i %4095s %i %i %i %i %i %i",
+			    &bucket, mapName, &width, &height,
+			    &startX, &startY, &goalX, &goalY) != 8)
+			continue; // the version line, or garbage
+
+		map *m = loadMap (mapName, path);
+		if (bucket < 0 || startX < 0 || startX >= m->width || goalX < 0 || goalX >= m->width ||
+		    startY < 0 || startY >= m->height || goalY < 0 || goalY >= m->height) {
+			fprintf (stderr, "scenario out of map bounds in %s: %s", path, line);
+			continue;
+		}
+
+		if (nScenarios == scenariosAllocated) {
+			scenariosAllocated = scenariosAllocated ? scenariosAllocated * 2 : 256;
+			scenarios = realloc (scenarios, scenariosAllocated * sizeof (scenario));
+			if (!scenarios) {
+				fprintf (stderr, "out of memory\n");
+				exit (1);
+			}
+		}
+		scenarios[nScenarios++] = (scenario) {
+			m, bucket,
+			astar_getIndexByWidth (m->width, startX, startY),
+			astar_getIndexByWidth (m->width, goalX, goalY)
+		};
+	}
+	fclose (scenFile);
+}
+
+static int compareStrings (const void *a, const void *b)
+{
+	return strcmp (*(char * const *) a, *(char * const *) b);
+}
+
+// a directory means every .scen file in it, in name order
+static void loadPath (const char *path)
+{
+	struct stat st;
+	if (stat (path, &st) || !S_ISDIR (st.st_mode)) {
+		loadScenarios (path);
+		return;
+	}
+
+	DIR *dir = opendir (path);
+	if (!dir) {
+		fprintf (stderr, "couldn't open directory %s: %s\n",
+			 path, strerror (errno));
+		exit (1);
+	}
+
+	char **names = NULL;
+	int nNames = 0;
+	struct dirent *entry;
+	while ((entry = readdir (dir))) {
+		size_t len = strlen (entry->d_name);
+		if (len < 5 || strcmp (entry->d_name + len - 5, ".scen"))
+			continue;
+		names = realloc (names, (nNames + 1) * sizeof (char *));
+		names[nNames] = malloc (strlen (path) + len + 2);
+		if (!names || !names[nNames]) {
+			fprintf (stderr, "out of memory\n");
+			exit (1);
+		}
+		sprintf (names[nNames++], "%s/%s", path, entry->d_name);
+	}
+	closedir (dir);
+
+	qsort (names, nNames, sizeof (char *), compareStrings);
+	for (int i = 0; i < nNames; i++) {
+		loadScenarios (names[i]);
+		free (names[i]);
+	}
+	free (names);
+}
+
+typedef enum { TEXT, CSV, JSON } format;
+
+static int rowsPrinted = 0;
+
+static void report (format fmt, const char *algorithm, int bucket, samples *s)
+{
+	if (!s->count)
+		return;
+
+	qsort (s->times, s->count, sizeof (double), compareDoubles);
+	double total = 0;
+	for (int i = 0; i < s->count; i++)
+		total += s->times[i];
+
+	double mean = total / s->count * 1e6;
+	double p50 = s->times[(s->count - 1) / 2] * 1e6;
+	double p99 = s->times[(int) ((s->count - 1) * 0.99)] * 1e6;
+	double throughput = total > 0 ? s->count / total : 0;
+
+	char bucketName[16] = "all";
+	if (bucket >= 0)
+		snprintf (bucketName, sizeof (bucketName), "%i", bucket);
+
+	switch (fmt) {
+	case TEXT:
+		printf ("%-12s %6s %8i %12.2f %12.2f %12.2f %14.1f\n",
+			algorithm, bucketName, s->count, mean, p50, p99, throughput);
+		break;
+	case CSV:
+		printf ("%s,%s,%i,%.3f,%.3f,%.3f,%.1f\n",
+			algorithm, bucketName, s->count, mean, p50, p99, throughput);
+		break;
+	case JSON:
+		printf ("%s\n    {\"algorithm\": \"%s\", \"bucket\": %s%s%s, \"queries\": %i, "
+			"\"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, "
+			"\"throughput_qps\": %.1f}",
+			rowsPrinted ? "," : "", algorithm,
+			bucket < 0 ? "\"" : "", bucketName, bucket < 0 ? "\"" : "",
+			s->count, mean, p50, p99, throughput);
+		break;
+	}
+	rowsPrinted++;
+}
+
+static void usage (void)
+{
+	fprintf (stderr, "benchAStar [-f text|csv|json] [-a algorithm,...] [-r repeats] [-m mapdir] <scenfile or directory>...\n");
+	fprintf (stderr, "(where scenario files are of the format used in http://movingai.com/benchmarks/)\n");
+	fprintf (stderr, "algorithms:");
+	for (int i = 0; i < N_ALGORITHMS; i++)
+		fprintf (stderr, " %s", algorithms[i].name);
+	fprintf (stderr, " (default: jps,unopt)\n");
+	exit (1);
+}
+
+int main (int argc, char **argv)
+{
+	format fmt = TEXT;
+	int repeats = 1;
+	int enabled[N_ALGORITHMS] = {1, 1};
+	int i = 1;
+
+	for (; i < argc && argv[i][0] == '-'; i++) {
+		if (i + 1 >= argc)
+			usage ();
+		if (!strcmp (argv[i], "-f")) {
+			i++;
+			if (!strcmp (argv[i], "text"))
+				fmt = TEXT;
+			else if (!strcmp (argv[i], "csv"))
+				fmt = CSV;
+			else if (!strcmp (argv[i], "json"))
+				fmt = JSON;
+			else
+				usage ();
+		}
+		else if (!strcmp (argv[i], "-a")) {
+			memset (enabled, 0, sizeof (enabled));
+			for (char *name = strtok (argv[++i], ","); name; name = strtok (NULL, ",")) {
+				int a;
+				for (a = 0; a < N_ALGORITHMS; a++)
+					if (!strcmp (name, algorithms[a].name))
+						break;
+				if (a == N_ALGORITHMS)
+					usage ();
+				enabled[a] = 1;
+			}
+		}
+		else if (!strcmp (argv[i], "-r"))
+			repeats = atoi (argv[++i]) > 0 ? atoi (argv[i]) : 1;
+		else if (!strcmp (argv[i], "-m"))
+			mapDir = argv[++i];
+		else
+			usage ();
+	}
+	if (i >= argc)
+		usage ();
+
+	for (; i < argc; i++)
+		loadPath (argv[i]);
+
+	int nBuckets = 0;
+	for (int s = 0; s < nScenarios; s++)
+		if (scenarios[s].bucket >= nBuckets)
+			nBuckets = scenarios[s].bucket + 1;
+
+	switch (fmt) {
+	case TEXT:
+		printf ("%-12s %6s %8s %12s %12s %12s %14s\n", "algorithm", "bucket",
+			"queries", "mean (us)", "p50 (us)", "p99 (us)", "queries/s");
+		break;
+	case CSV:
+		printf ("algorithm,bucket,queries,mean_us,p50_us,p99_us,throughput_qps\n");
+		break;
+	case JSON:
+		printf ("{\"scenarios\": %i, \"repeats\": %i, \"results\": [",
+			nScenarios, repeats);
+		break;
+	}
+
+	int mismatches = 0;
+	int *lengths = malloc (nScenarios * sizeof (int));
+	samples *buckets = calloc (nBuckets, sizeof (samples));
+	if ((nScenarios && !lengths) || (nBuckets && !buckets)) {
+		fprintf (stderr, "out of memory\n");
+		exit (1);
+	}
+
+	int first = 1;
+	for (int a = 0; a < N_ALGORITHMS; a++) {
+		if (!enabled[a])
+			continue;
+
+		samples all = {NULL, 0, 0};
+		for (int r = 0; r < repeats; r++) {
+			for (int s = 0; s < nScenarios; s++) {
+				scenario *sc = &scenarios[s];
+				int solLength;
+				double t0 = now ();
+				free (algorithms[a].run (sc->map, &solLength, sc->start, sc->end));
+				double t = now () - t0;
+
+				addSample (&buckets[sc->bucket], t);
+				addSample (&all, t);
+
+				// the optimal algorithms had all better agree
+				// on the length; the others, at least on
+				// whether there's a path
+				if (r > 0)
+					continue;
+				if (first)
+					lengths[s] = solLength;
+				else if (algorithms[a].optimal ?
+					 lengths[s] != solLength :
+					 (lengths[s] >= 0) != (solLength >= 0))
+					mismatches++;
+			}
+		}
+		if (algorithms[a].optimal)
+			first = 0;
+
+		for (int b = 0; b < nBuckets; b++) {
+			report (fmt, algorithms[a].name, b, &buckets[b]);
+			free (buckets[b].times);
+			buckets[b] = (samples) {NULL, 0, 0};
+		}
+		report (fmt, algorithms[a].name, -1, &all);
+		free (all.times);
+	}
+
+	if (fmt == JSON)
+		printf ("\n  ],\n  \"mismatches\": %i\n}\n", mismatches);
+	if (mismatches)
+		fprintf (stderr, "%i queries had different path lengths between algorithms\n",
+			 mismatches);
+
+	free (buckets);
+	free (lengths);
+	free (scenarios);
+	freeMaps ();
+	return mismatches != 0;
+}
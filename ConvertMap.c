@@ -0,0 +1,86 @@
+#include "AStar.h"
+#include "AStarMap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Converts a map from http://movingai.com/benchmarks/ into a map file (see
+   AStarMap.h), which testAStar and astar_map_open then load without
+   parsing anything. */
+
+static void usage (void)
+{
+	fprintf (stderr, "convertMap [-b] [-j] [-l <count> [-q]] <map file> <output file>\n");
+	fprintf (stderr, "  -b  store the grid a bit per cell\n");
+	fprintf (stderr, "  -j  precompute JPS+ tables and store them too\n");
+	fprintf (stderr, "  -l  precompute tables for count landmarks and store them too\n");
+	fprintf (stderr, "  -q  quantize the landmark tables to 16 bits\n");
+	exit (1);
+}
+
+int main (int argc, char **argv)
+{
+	int packed = 0, withJpsplus = 0, nLandmarks = 0, quantized = 0;
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (!strcmp (argv[arg], "-b"))
+			packed = 1;
+		else if (!strcmp (argv[arg], "-j"))
+			withJpsplus = 1;
+		else if (!strcmp (argv[arg], "-l") && arg + 1 < argc) {
+			nLandmarks = atoi (argv[++arg]);
+			if (nLandmarks <= 0)
+				usage ();
+		}
+		else if (!strcmp (argv[arg], "-q"))
+			quantized = 1;
+		else
+			usage ();
+	}
+	if (argc - arg != 2 || (quantized && !nLandmarks))
+		usage ();
+
+	int width, height;
+	char *grid = astar_map_read_movingai (argv[arg], &width, &height);
+	if (!grid) {
+		fprintf (stderr, "couldn't read map file %s\n", argv[arg]);
+		exit (1);
+	}
+
+	astar_map_section_t sections[2];
+	int nSections = 0;
+	astar_jpsplus_t *jpsplus = NULL;
+	if (withJpsplus) {
+		jpsplus = astar_jpsplus_create (grid, width, height);
+		if (!jpsplus) {
+			fprintf (stderr, "couldn't build JPS+ tables\n");
+			exit (1);
+		}
+		sections[nSections].tag = ASTAR_MAP_SECTION_JPSPLUS;
+		sections[nSections].data = astar_jpsplus_tables (jpsplus);
+		sections[nSections].size = sizeof (int) * 8 * (size_t) width * height;
+		nSections++;
+	}
+
+	astar_landmarks_t *landmarks = NULL;
+	if (nLandmarks) {
+		landmarks = astar_landmarks_create (grid, width, height, nLandmarks, quantized);
+		if (!landmarks) {
+			fprintf (stderr, "couldn't build landmark tables\n");
+			exit (1);
+		}
+		sections[nSections].tag = ASTAR_MAP_SECTION_LANDMARKS;
+		sections[nSections].data = astar_landmarks_tables (landmarks, &sections[nSections].size);
+		nSections++;
+	}
+
+	if (astar_map_write (argv[arg + 1], grid, width, height, packed, sections, nSections)) {
+		fprintf (stderr, "couldn't write %s\n", argv[arg + 1]);
+		exit (1);
+	}
+
+	astar_jpsplus_free (jpsplus);
+	astar_landmarks_free (landmarks);
+	free (grid);
+	return 0;
+}
@@ -22,85 +22,395 @@ int makeSpace (queue *q, size_t size)
         if (newAllocated <= q->allocated)
                 return 0;
 
-        q->root = realloc (q->root, newAllocated);
-        if (NULL == q->root)
-                exit (1); // I'm a bloody Haskell programmer, I don't have any business trying to do anything fancy when realloc fails
+        item *root = q->alloc.realloc (q->alloc.user, q->root, q->allocated, newAllocated);
+        if (NULL == root)
+                return -1;
 
+        q->root = root;
         q->allocated = newAllocated;
         return newAllocated;
 }
 
+// returns the grown array, or NULL, leaving array as it was
+static void *growArray (queue *q, void *array, size_t oldCount, size_t newCount, size_t size, int fill)
+{
+	array = q->alloc.realloc (q->alloc.user, array, oldCount * size, newCount * size);
+	if (NULL == array)
+		return NULL;
+	memset ((char *) array + oldCount * size, fill, (newCount - oldCount) * size);
+	return array;
+}
+
+/* make sure the per-value arrays have room for value; returns -1 if they
+   can't be grown. The ones that did grow before one failed are just
+   grown again the next time, from the old size */
+static int reserveValues (queue *q, int value)
+{
+	if ((value + 1) * sizeof (int) <= q->indexAllocated)
+		return 0;
+
+	unsigned int newAllocated = smallestPowerOfTwoAfter ((value + 1) * sizeof(int));
+	size_t oldCount = q->indexAllocated / sizeof (int);
+	size_t newCount = newAllocated / sizeof (int);
+
+	int *index = growArray (q, q->index, oldCount, newCount, sizeof (int), -1);
+	if (NULL == index)
+		return -1;
+	q->index = index;
+	if (q->kind == QUEUE_RADIX_HEAP) {
+		unsigned char *bucketOf = growArray (q, q->bucketOf, oldCount, newCount, 1, 0);
+		if (NULL == bucketOf)
+			return -1;
+		q->bucketOf = bucketOf;
+	}
+	if (q->kind == QUEUE_BUCKET) {
+		int *next = growArray (q, q->next, oldCount, newCount, sizeof (int), -1);
+		if (NULL == next)
+			return -1;
+		q->next = next;
+		int *prev = growArray (q, q->prev, oldCount, newCount, sizeof (int), -1);
+		if (NULL == prev)
+			return -1;
+		q->prev = prev;
+		double *priorities = growArray (q, q->priorities, oldCount, newCount, sizeof (double), 0);
+		if (NULL == priorities)
+			return -1;
+		q->priorities = priorities;
+	}
+	q->indexAllocated = newAllocated;
+	return 0;
+}
+
+// there must be room for the item already (see makeSpace)
 int placeAtEnd (queue *q, item item)
 {
-	makeSpace (q, q->size + 1);
 	q->root[q->size] = item;
 	return q->size++;
 }
 
+
+/* d-ary heaps. The sifts move a hole instead of swapping at every level,
+   and are written for a constant d so that the compiler can turn the
+   divisions into shifts. */
+
+static inline void siftUpD (queue *q, int i, int d)
+{
+	item it = q->root[i];
+	while (i > 0) {
+		int p = (i - 1) / d;
+		if (q->root[p].priority < it.priority)
+			break;
+		q->root[i] = q->root[p];
+		q->index[q->root[i].value] = i;
+		i = p;
+	}
+	q->root[i] = it;
+	q->index[it.value] = i;
+}
+
+static inline void siftDownD (queue *q, int i, int d)
+{
+	item it = q->root[i];
+	for (;;) {
+		int c = d * i + 1;
+		if (c >= q->size)
+			break;
+
+		int end = c + d < q->size ? c + d : q->size;
+		int smallest = c;
+		for (int j = c + 1; j < end; j++)
+			if (q->root[j].priority < q->root[smallest].priority)
+				smallest = j;
+
+		if (it.priority < q->root[smallest].priority)
+			break;
+
+		q->root[i] = q->root[smallest];
+		q->index[q->root[i].value] = i;
+		i = smallest;
+	}
+	q->root[i] = it;
+	q->index[it.value] = i;
+}
+
 void siftUp (queue *q, int i)
 {
-	if (0 == i)
-		return;
+	if (q->kind == QUEUE_QUATERNARY_HEAP)
+		siftUpD (q, i, 4);
+	else
+		siftUpD (q, i, 2);
+}
 
-	int p = (i - 1) / 2;
+void siftDown (queue *q, int i)
+{
+	if (q->kind == QUEUE_QUATERNARY_HEAP)
+		siftDownD (q, i, 4);
+	else
+		siftDownD (q, i, 2);
+}
 
-	if (q->root[p].priority < q->root[i].priority)
-		return;
 
-	q->index[q->root[i].value] = p;
-	q->index[q->root[p].value] = i;
+/* Radix heap. Priorities are mapped to 64-bit keys that sort the same way,
+   and an item goes in bucket 0 if its key equals the key of the last item
+   removed, or otherwise in bucket i where i - 1 is the highest bit in which
+   the two keys differ. Bucket 0 thus holds the minimum; when it runs empty,
+   the smallest non-empty bucket is emptied into lower buckets relative to
+   its own minimum. */
 
-	item swap = q->root[i];
-	q->root[i] = q->root[p];
-	q->root[p] = swap;
+static uint64_t radixKey (double priority)
+{
+	uint64_t bits;
+	memcpy (&bits, &priority, sizeof (bits));
+	// flip the sign bit of positive numbers and all bits of negative
+	// ones, so that the keys compare like the doubles do
+	return bits >> 63 ? ~bits : bits | (uint64_t) 1 << 63;
+}
 
-	return siftUp (q, p);
+static int bucketRelativeTo (uint64_t last, uint64_t key)
+{
+	return key == last ? 0 : 64 - __builtin_clzll (key ^ last);
 }
 
-void insert (queue *q, int value, double pri)
+static int radixBucketFor (const queue *q, uint64_t key)
 {
-	item i;
-	i.value = value;
-	i.priority = pri;
+	return bucketRelativeTo (q->last, key);
+}
 
-        int newAllocated = smallestPowerOfTwoAfter ((value + 1) * sizeof(int));
+// make sure bucket b has room for count items
+static int radixReserve (queue *q, int b, int count)
+{
+	radixBucket *bucket = &q->buckets[b];
+	if (count <= bucket->allocated)
+		return 0;
+
+	int allocated = bucket->allocated ? bucket->allocated : 16;
+	while (allocated < count)
+		allocated *= 2;
+	item *items = q->alloc.realloc (q->alloc.user, bucket->items,
+					bucket->allocated * sizeof (item), 
+					allocated * sizeof (item));
+	if (NULL == items)
+		return -1;
+	bucket->items = items;
+	bucket->allocated = allocated;
+	return 0;
+}
 
-        if ((value + 1) * sizeof (int) > q->indexAllocated) {
-		q->index = realloc (q->index, newAllocated);
-		if (NULL == q->index)
-			exit (1);
-		for (unsigned int j = q->indexAllocated / sizeof (int); j < newAllocated / sizeof (int); j++)
-			q->index[j] = -1;
-		q->indexAllocated = newAllocated;
+/* Make room for an item with this key to be inserted, so that radixInsert
+   can't run out; it's done first so that the queue is left as it was if
+   there isn't the memory. A key below the last one moves every item, so
+   all of them are counted into the buckets they'll go to. */
+static int radixMakeRoom (queue *q, uint64_t key)
+{
+	if (key >= q->last) {
+		int b = radixBucketFor (q, key);
+		return radixReserve (q, b, q->buckets[b].size + 1);
 	}
 
-	int p = placeAtEnd (q, i);
+	if (makeSpace (q, q->size) < 0)
+		return -1;
+	int counts[65] = {0};
+	counts[0] = 1;
+	for (int b = 0; b < 65; b++)
+		for (int i = 0; i < q->buckets[b].size; i++)
+			counts[bucketRelativeTo (key, radixKey (q->buckets[b].items[i].priority))]++;
+	for (int b = 0; b < 65; b++)
+		if (radixReserve (q, b, counts[b]))
+			return -1;
+	return 0;
+}
 
-	q->index[q->root[p].value] = p;	
+// there must be room in bucket b (see radixReserve)
+static void radixPush (queue *q, int b, item it)
+{
+	radixBucket *bucket = &q->buckets[b];
+	q->index[it.value] = bucket->size;
+	q->bucketOf[it.value] = b;
+	bucket->items[bucket->size++] = it;
+}
 
-	siftUp (q, p);
+static void radixRemove (queue *q, int value)
+{
+	radixBucket *bucket = &q->buckets[q->bucketOf[value]];
+	int i = q->index[value];
+	bucket->items[i] = bucket->items[--bucket->size];
+	q->index[bucket->items[i].value] = i;
+	q->index[value] = -1;
+	q->size--;
 }
 
-void siftDown (queue *q, int i)
+// radixMakeRoom must have made room for it
+static void radixInsert (queue *q, item it)
 {
-	int c = 1 + 2 * i;
-	if (c >= q->size)
-		return;
+	uint64_t key = radixKey (it.priority);
+
+	if (key < q->last) {
+		// not monotone after all; put everything back relative to
+		// the new minimum, using root as scratch space
+		int n = 0;
+		for (int b = 0; b < 65; b++) {
+			for (int i = 0; i < q->buckets[b].size; i++)
+				q->root[n++] = q->buckets[b].items[i];
+			q->buckets[b].size = 0;
+		}
+		q->last = key;
+		for (int i = 0; i < n; i++)
+			radixPush (q, radixBucketFor (q, radixKey (q->root[i].priority)), q->root[i]);
+	}
 
-	if ((c + 1 < q->size) && (q->root[c].priority > q->root[(c+1)].priority))
-		c++;
+	radixPush (q, radixBucketFor (q, key), it);
+	q->size++;
+}
 
-	if (q->root[i].priority < q->root[c].priority)
-		return;
+static item *radixFindMin (queue *q)
+{
+	if (0 == q->size)
+		return NULL;
+
+	if (0 == q->buckets[0].size) {
+		int b = 1;
+		while (0 == q->buckets[b].size)
+			b++;
+
+		radixBucket *bucket = &q->buckets[b];
+		uint64_t min = radixKey (bucket->items[0].priority);
+		int minAt = 0;
+		for (int i = 1; i < bucket->size; i++) {
+			uint64_t key = radixKey (bucket->items[i].priority);
+			if (key < min) {
+				min = key;
+				minAt = i;
+			}
+		}
+
+		// Without the memory to spread the bucket out, the minimum is
+		// taken from where it is. Every item in lower buckets is still
+		// lower than every item in higher ones, so that's correct, if
+		// slower.
+		int counts[65] = {0};
+		for (int i = 0; i < bucket->size; i++)
+			counts[bucketRelativeTo (min, radixKey (bucket->items[i].priority))]++;
+		for (int t = 0; t < b; t++)
+			if (radixReserve (q, t, q->buckets[t].size + counts[t]))
+				return &bucket->items[minAt];
+
+		// every item moves to a lower bucket than b, so this doesn't
+		// disturb the items we're still iterating over
+		q->last = min;
+		for (int i = 0; i < bucket->size; i++)
+			radixPush (q, radixBucketFor (q, radixKey (bucket->items[i].priority)),
+				   bucket->items[i]);
+		bucket->size = 0;
+	}
+
+	return &q->buckets[0].items[q->buckets[0].size - 1];
+}
+
+
+/* Bucket queue. The buckets are intrusive doubly linked lists threaded
+   through next and prev, and cursor never passes a non-empty bucket. */
+
+static int bucketKey (double priority)
+{
+	return priority > 0 ? (int) priority : 0;
+}
 
-	q->index[q->root[c].value] = i;
-	q->index[q->root[i].value] = c;
+// make sure there's a list for key
+static int bucketReserve (queue *q, int key)
+{
+	if (key < q->nHeads)
+		return 0;
+
+	int newHeads = q->nHeads ? q->nHeads : 1024;
+	while (newHeads <= key)
+		newHeads *= 2;
+	int *heads = growArray (q, q->heads, q->nHeads, newHeads, sizeof (int), -1);
+	if (NULL == heads)
+		return -1;
+	q->heads = heads;
+	q->nHeads = newHeads;
+	return 0;
+}
+
+// bucketReserve must have made room for it
+static void bucketInsert (queue *q, int value, double priority)
+{
+	int key = bucketKey (priority);
+	q->next[value] = q->heads[key];
+	q->prev[value] = -1;
+	if (q->heads[key] != -1)
+		q->prev[q->heads[key]] = value;
+	q->heads[key] = value;
+
+	q->index[value] = key;
+	q->priorities[value] = priority;
+	if (key < q->cursor)
+		q->cursor = key;
+	if (key > q->maxKey)
+		q->maxKey = key;
+	q->size++;
+}
+
+static void bucketRemove (queue *q, int value)
+{
+	int key = q->index[value];
+	if (q->prev[value] != -1)
+		q->next[q->prev[value]] = q->next[value];
+	else
+		q->heads[key] = q->next[value];
+	if (q->next[value] != -1)
+		q->prev[q->next[value]] = q->prev[value];
+	q->index[value] = -1;
+	q->size--;
+}
+
+static item *bucketFindMin (queue *q)
+{
+	if (0 == q->size)
+		return NULL;
+
+	while (q->heads[q->cursor] == -1)
+		q->cursor++;
+
+	int value = q->heads[q->cursor];
+	q->min.value = value;
+	q->min.priority = q->priorities[value];
+	return &q->min;
+}
+
+
+int insert (queue *q, int value, double pri)
+{
+	item i;
+	i.value = value;
+	i.priority = pri;
 
-	item swap = q->root[i];
-	q->root[i] = q->root[c];
-	q->root[c] = swap;
+	if (reserveValues (q, value))
+		return -1;
+
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		if (radixMakeRoom (q, radixKey (pri)))
+			return -1;
+		radixInsert (q, i);
+		return 0;
+	case QUEUE_BUCKET:
+		if (bucketReserve (q, bucketKey (pri)))
+			return -1;
+		bucketInsert (q, value, pri);
+		return 0;
+	default:
+		break;
+	}
+
+	if (makeSpace (q, q->size + 1) < 0)
+		return -1;
+	int p = placeAtEnd (q, i);
+
+	q->index[q->root[p].value] = p;
 
-	return siftDown (q, c);
+	siftUp (q, p);
+	return 0;
 }
 
 void deleteMin (queue *q)
@@ -108,6 +418,17 @@ void deleteMin (queue *q)
 	if (0 == q->size)
 		return;
 
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		radixRemove (q, radixFindMin (q)->value);
+		return;
+	case QUEUE_BUCKET:
+		bucketRemove (q, bucketFindMin (q)->value);
+		return;
+	default:
+		break;
+	}
+
 	q->index[q->root[0].value] = -1;
 	q->size--;
 
@@ -118,58 +439,161 @@ void deleteMin (queue *q)
 	q->root[0] = q->root[q->size];
 
 	siftDown (q, 0);
-} 
+}
 
-item *findMin (const queue *q)
+item *findMin (queue *q)
 {
-	return q->root;
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		return radixFindMin (q);
+	case QUEUE_BUCKET:
+		return bucketFindMin (q);
+	default:
+		return q->root;
+	}
 }
 
-void changePriority (queue *q, int ind, double newPriority)
+int changePriority (queue *q, int ind, double newPriority)
 {
-	int oldPriority = q->root[q->index[ind]].priority;
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		if (radixMakeRoom (q, radixKey (newPriority)))
+			return -1;
+		radixRemove (q, ind);
+		radixInsert (q, (item) {newPriority, ind});
+		return 0;
+	case QUEUE_BUCKET:
+		if (bucketReserve (q, bucketKey (newPriority)))
+			return -1;
+		bucketRemove (q, ind);
+		bucketInsert (q, ind, newPriority);
+		return 0;
+	default:
+		break;
+	}
+
+	double oldPriority = q->root[q->index[ind]].priority;
 	q->root[q->index[ind]].priority = newPriority;
 	if (oldPriority < newPriority)
 		siftDown (q, q->index[ind]);
 	else if (oldPriority > newPriority)
 		siftUp (q, q->index[ind]);
+	return 0;
 }
 
 void delete (queue *q, int ind)
 {
-	changePriority (q, ind, INT_MIN);
-	deleteMin (q);
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		radixRemove (q, ind);
+		return;
+	case QUEUE_BUCKET:
+		bucketRemove (q, ind);
+		return;
+	default:
+		break;
+	}
+
+	// fill the hole with the last item, which may belong either above
+	// or below it
+	int i = q->index[ind];
+	q->index[ind] = -1;
+	q->size--;
+	if (i == q->size)
+		return;
+
+	int moved = q->root[q->size].value;
+	q->root[i] = q->root[q->size];
+	q->index[moved] = i;
+	siftUp (q, i);
+	siftDown (q, q->index[moved]);
 }
 
-int priorityOf (const queue *q, int ind)
+double priorityOf (const queue *q, int ind)
 {
-	return q->root[q->index[ind]].priority;
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		return q->buckets[q->bucketOf[ind]].items[q->index[ind]].priority;
+	case QUEUE_BUCKET:
+		return q->priorities[ind];
+	default:
+		return q->root[q->index[ind]].priority;
+	}
 }
 
 int exists (const queue *q, int ind)
 {
-	return  (q->indexAllocated / sizeof (int) > ind) &&
-		(-1 != q->index[ind]) && 
-		(q->size > q->index[ind]);
+	return  (q->indexAllocated / sizeof (int) > (unsigned int) ind) &&
+		(-1 != q->index[ind]);
 }
 
-queue* createQueue ()
+queue *createQueueOfKind (queue_kind kind, int capacity)
+{
+	return createQueueWithAllocator (kind, capacity, NULL);
+}
+
+queue *createQueueWithAllocator (queue_kind kind, int capacity, const astar_allocator_t *alloc)
 {
-	queue *rv = (queue*) malloc (sizeof (queue));
+	if (NULL == alloc)
+		alloc = &astar_default_allocator;
+	queue *rv = alloc->malloc (alloc->user, sizeof (queue));
 	if (NULL == rv)
-		exit (1);
-	rv->size = 0;
-	rv->allocated = 0;
-	rv->root = NULL;
-	rv->index = NULL;
-	rv->indexAllocated = 0;
+		return NULL;
+	memset (rv, 0, sizeof (queue));
+	rv->alloc = *alloc;
+	rv->kind = kind;
+	if (capacity > 0 && reserveValues (rv, capacity - 1)) {
+		freeQueue (rv);
+		return NULL;
+	}
 	return rv;
 }
 
-void freeQueue (queue* q)
+queue* createQueue ()
 {
-	free (q->root);
-	free (q->index);
-	free (q);
+	return createQueueOfKind (QUEUE_BINARY_HEAP, 0);
 }
 
+// empty the queue but keep its buffers around for the next user
+void clearQueue (queue *q)
+{
+	switch (q->kind) {
+	case QUEUE_RADIX_HEAP:
+		for (int b = 0; b < 65; b++) {
+			for (int i = 0; i < q->buckets[b].size; i++)
+				q->index[q->buckets[b].items[i].value] = -1;
+			q->buckets[b].size = 0;
+		}
+		q->last = 0;
+		break;
+	case QUEUE_BUCKET:
+		for (int key = q->cursor; key <= q->maxKey && key < q->nHeads; key++) {
+			for (int v = q->heads[key]; v != -1; v = q->next[v])
+				q->index[v] = -1;
+			q->heads[key] = -1;
+		}
+		q->cursor = 0;
+		q->maxKey = 0;
+		break;
+	default:
+		for (int i = 0; i < q->size; i++)
+			q->index[q->root[i].value] = -1;
+		break;
+	}
+	q->size = 0;
+}
+
+void freeQueue (queue* q)
+{
+	astar_allocator_t alloc = q->alloc;
+	for (int b = 0; b < 65; b++)
+		alloc.free (alloc.user, q->buckets[b].items);
+	alloc.free (alloc.user, q->root);
+	alloc.free (alloc.user, q->index);
+	alloc.free (alloc.user, q->bucketOf);
+	alloc.free (alloc.user, q->heads);
+	alloc.free (alloc.user, q->next);
+	alloc.free (alloc.user, q->prev);
+	alloc.free (alloc.user, q->priorities);
+	alloc.free (alloc.user, q);
+}
@@ -1,27 +1,92 @@
 #ifndef PRIORITYQUEUE_H_
 #define PRIORITYQUEUE_H_
 
+#include "AStarAlloc.h"
+#include <stdint.h>
+
 typedef struct item {
 	double priority;
 	int value;
 } item;
 
+/* The queue can be backed by one of several data structures, all behind
+   the same interface:
+
+   QUEUE_BINARY_HEAP, QUEUE_QUATERNARY_HEAP: d-ary heaps. A 4-ary heap is
+   half as deep as a binary one, and a node's children sit next to each
+   other in memory, so it usually takes fewer cache misses per operation.
+
+   QUEUE_RADIX_HEAP: for monotone priorities, i.e. no priority inserted is
+   lower than the last one removed, which holds for A* with a consistent
+   heuristic. Inserts are O(1), and deleteMin is amortized O(log C) for
+   priorities of C distinct bit patterns. Breaking monotonicity is allowed
+   but slow.
+
+   QUEUE_BUCKET: a bucket per integer priority, for small integer priority
+   ranges. Priorities are truncated to integers, and values with the same
+   integer priority come out in no particular order, so it's only exact if
+   all priorities are integers.
+ */
+typedef enum queue_kind {
+	QUEUE_BINARY_HEAP,
+	QUEUE_QUATERNARY_HEAP,
+	QUEUE_RADIX_HEAP,
+	QUEUE_BUCKET
+} queue_kind;
+
+typedef struct radixBucket {
+	item *items;
+	int size;
+	int allocated;
+} radixBucket;
+
 typedef struct queue {
+	queue_kind kind;
 	int size;
 	unsigned int allocated;
 	item *root;
+	// position of each value in the heap (or in its radix bucket), -1 if
+	// it's not in the queue; for bucket queues, its integer priority
 	int *index;
 	unsigned int indexAllocated;
+
+	// radix heap: the key of the last item removed, and which bucket
+	// each value is in
+	uint64_t last;
+	radixBucket buckets[65];
+	unsigned char *bucketOf;
+
+	// bucket queue: a doubly linked list per integer priority, the
+	// lowest priority that may be non-empty, and the highest one used
+	int *heads;
+	int nHeads;
+	int cursor;
+	int maxKey;
+	int *next;
+	int *prev;
+	double *priorities;
+	item min;
+
+	astar_allocator_t alloc;
 } queue;
 
-void insert (queue *q, int value, double priority);
+/* insert and changePriority return -1, leaving the queue as it was, if
+   there isn't the memory for the change, and 0 otherwise */
+int insert (queue *q, int value, double priority);
 void deleteMin (queue *q);
-item *findMin (const queue *q);
-void changePriority (queue *q, int ind, double newPriority);
+item *findMin (queue *q);
+int changePriority (queue *q, int ind, double newPriority);
 void delete (queue *q, int ind);
-int priorityOf (const queue *q, int ind);
+double priorityOf (const queue *q, int ind);
 int exists (const queue *q, int ind);
 queue *createQueue ();
+/* capacity: values will be in [0, capacity), so the per-value arrays can be
+   allocated up front instead of grown during inserts */
+queue *createQueueOfKind (queue_kind kind, int capacity);
+/* the queue's memory comes from alloc, or malloc if it's NULL; the create
+   functions return NULL if there isn't the memory */
+queue *createQueueWithAllocator (queue_kind kind, int capacity, const astar_allocator_t *alloc);
+void clearQueue (queue *q);
 void freeQueue (queue *q);
 
 #endif
@@ -1,8 +1,73 @@
 #include "AStar.h"
+#include "AStarBatch.h"
+#include "AStarCache.h"
+#include "AStarDStar.h"
+#include "AStarHierarchy.h"
+#include "AStarMap.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <errno.h>
+
+// does the path, goal first, take only steps the movement rules allow?
+static int stepsAllowed (const char *grid, int width, const int *path, int length)
+{
+	for (int i = 0; i < length; i++) {
+		int x, y, fromX, fromY;
+		astar_getCoordByWidth (width, path[i], &x, &y);
+		astar_getCoordByWidth (width, path[i + 1], &fromX, &fromY);
+		int dx = x - fromX, dy = y - fromY;
+		if (!grid[path[i]] || abs (dx) > 1 || abs (dy) > 1 || (!dx && !dy))
+			return 0;
+		if (dx && dy && 
+		    (ASTAR_MOVEMENT == ASTAR_MOVE_STRAIGHT ||
+		     (ASTAR_MOVEMENT == ASTAR_MOVE_NO_CORNER_CUTTING &&
+		      (!grid[astar_getIndexByWidth (width, fromX + dx, fromY)] ||
+		       !grid[astar_getIndexByWidth (width, fromX, fromY + dy)]))))
+			return 0;
+	}
+	return 1;
+}
+
+// the cost of a path, with diagonal steps at sqrt(2) whatever the build's
+// step costs are, as in the scenario files
+static double pathCost (int width, const int *path, int length)
+{
+	double cost = 0;
+	for (int i = 0; i < length; i++) {
+		int x, y, fromX, fromY;
+		astar_getCoordByWidth (width, path[i], &x, &y);
+		astar_getCoordByWidth (width, path[i + 1], &fromX, &fromY);
+		cost += x != fromX && y != fromY ? 1.4142135623730951 : 1;
+	}
+	return cost;
+}
+
+// an allocator that only gives out so many blocks, user pointing to how
+// many are left, to check that searches that run out of memory say so
+static void *rationedMalloc (void *user, size_t size)
+{
+	int *left = user;
+	if (*left <= 0)
+		return NULL;
+	(*left)--;
+	return malloc (size);
+}
+
+static void *rationedRealloc (void *user, void *ptr, size_t oldSize, size_t newSize)
+{
+	(void) oldSize;
+	int *left = user;
+	if (*left <= 0)
+		return NULL;
+	(*left)--;
+	return realloc (ptr, newSize);
+}
+
+static void rationedFree (void *user, void *ptr)
+{
+	(void) user;
+	free (ptr);
+}
 
 int main (int argc, char **argv)
 {
@@ -21,47 +86,512 @@ int main (int argc, char **argv)
 	fscanf (scenFile, "version 1.0\n");
 	char mapFileBuf[255];
 	int bucket, height, width, startX, startY, goalX, goalY, optimal;
-	double something;
+	double optimalCost;
 	fscanf (scenFile, "%i %s %i %i %i %i %i %i %i %lf\n", 
 		&bucket, mapFileBuf, &width, &height, &startX, &startY,
-		&goalX, &goalY, &optimal, &something);
+		&goalX, &goalY, &optimal, &optimalCost);
+
+	// either a map file made by convertMap, or a map in the ASCII format
+	astar_map_t *map = astar_map_open (mapFileBuf);
+	char *asciiGrid = NULL;
+	const char *grid;
+	if (map) {
+		grid = astar_map_grid (map);
+		width = astar_map_width (map);
+		height = astar_map_height (map);
+	}
+	else {
+		asciiGrid = astar_map_read_movingai (mapFileBuf, &width, &height);
+		if (!asciiGrid) {
+			fprintf (stderr, "couldn't read map file %s\n", mapFileBuf);
+			exit (1);
+		}
+		grid = asciiGrid;
+	}
+
+	astar_context_t *ctx = astar_context_create (width, height);
+	if (!ctx) {
+		fprintf (stderr, "couldn't allocate a search context\n");
+		exit (1);
+	}
 
-	FILE *mapFile = fopen (mapFileBuf, "r");
-	if (!mapFile) {
-		fprintf (stderr, "couldn't open map file %s: %s\n", 
-			 mapFileBuf, strerror(errno));
+	// for the backward half of bidirectional searches
+	astar_context_t *backCtx = astar_context_create (width, height);
+	if (!backCtx) {
+		fprintf (stderr, "couldn't allocate a search context\n");
 		exit (1);
 	}
 
-	fscanf (mapFile, "type octile\nheight %i\nwidth %i\nmap\n", &height, &width);
+	// for paths within 20% of the shortest
+	astar_context_t *weightedCtx = astar_context_create (width, height);
+	if (!weightedCtx || !astar_context_set_weight (weightedCtx, 1.2)) {
+		fprintf (stderr, "couldn't allocate a search context\n");
+		exit (1);
+	}
 
-	char grid[width*height];
-	memset (grid, 0, sizeof (char) * width * height);
+	// with landmarks, from the map file if it has them (and they were
+	// saved with the cost type of this build), and quantized
+	size_t landmarkSize;
+	const void *landmarkTables = map ? astar_map_section (map, ASTAR_MAP_SECTION_LANDMARKS, &landmarkSize) : NULL;
+	astar_landmarks_t *landmarks = landmarkTables ? 
+		astar_landmarks_create_from_tables (width, height, landmarkTables, landmarkSize) : NULL;
+	if (!landmarks)
+		landmarks = astar_landmarks_create (grid, width, height, 8, 0);
+	astar_landmarks_t *quantizedLandmarks = astar_landmarks_create (grid, width, height, 8, 1);
+	astar_context_t *landmarkCtx = astar_context_create (width, height);
+	astar_context_t *quantizedCtx = astar_context_create (width, height);
+	if (!landmarks || !quantizedLandmarks || !landmarkCtx || !quantizedCtx || 
+	    !astar_context_set_landmarks (landmarkCtx, landmarks) || 
+	    !astar_context_set_landmarks (quantizedCtx, quantizedLandmarks)) {
+		fprintf (stderr, "couldn't build the landmark tables\n");
+		exit (1);
+	}
 
-	for (int i = 0; i < height; i++) {
-		char buf[width + 1]; // space for a newline
-		fread (buf, 1, width + 1, mapFile);
-		for (int j = 0; j < width; j++) {
-			if (buf[j] == '.' || buf[j] == 'G')
-				grid[width*i+j] = 1;
-			else
-				grid[width*i+j] = 0;
-		}
+	// these only exist for the default movement rules and layout
+	astar_jpsplus_t *jpsplus = NULL;
+	astar_bitgrid_t *bitgrid = NULL;
+	astar_neighbours_t *neighbours = NULL;
+#if ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL && ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+	// use the JPS+ tables in the map file if it has them
+	size_t tablesSize;
+	const int *tables = map ? astar_map_section (map, ASTAR_MAP_SECTION_JPSPLUS, &tablesSize) : NULL;
+	if (tables && tablesSize == sizeof (int) * 8 * width * height)
+		jpsplus = astar_jpsplus_create_from_tables (grid, width, height, tables);
+	else
+		jpsplus = astar_jpsplus_create (grid, width, height);
+	if (!jpsplus) {
+		fprintf (stderr, "couldn't build JPS+ tables\n");
+		exit (1);
+	}
+
+	bitgrid = astar_bitgrid_create (grid, width, height);
+	if (!bitgrid) {
+		fprintf (stderr, "couldn't build the bit grid\n");
+		exit (1);
+	}
+
+	// built up from an empty map one cell at a time, so that the queries
+	// check astar_neighbours_set too
+	char *emptyGrid = calloc ((size_t) width * height, 1);
+	neighbours = emptyGrid ? astar_neighbours_create (emptyGrid, width, height) : NULL;
+	if (!neighbours) {
+		fprintf (stderr, "couldn't build the neighbourhood masks\n");
+		exit (1);
+	}
+	free (emptyGrid);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+			if (grid[astar_getIndexByWidth (width, x, y)])
+				astar_neighbours_set (neighbours, x, y, 1);
+#endif
+
+	astar_components_t *components = astar_components_create (grid, width, height);
+	if (!components) {
+		fprintf (stderr, "couldn't label the connected components\n");
+		exit (1);
 	}
+
+	astar_hierarchy_t *hierarchy = astar_hierarchy_create (grid, width, height, 16);
+	if (!hierarchy) {
+		fprintf (stderr, "couldn't build the hierarchy\n");
+		exit (1);
+	}
+
+	// big enough for any path
+	int *pathBuf = malloc ((size_t) width * height * sizeof (int));
+
+	// big enough to hold every query, so running them all again at the
+	// end should hit every time
+	astar_cache_t *cache = astar_cache_create (width, height, 4096);
+	if (!cache) {
+		fprintf (stderr, "couldn't create the path cache\n");
+		exit (1);
+	}
+
+	// every query is run once more as one batch at the end
+	int nQueries = 0;
+	int queriesAllocated = 64;
+	astar_query_t *queries = malloc (queriesAllocated * sizeof (astar_query_t));
+	int *lengths = malloc (queriesAllocated * sizeof (int));
+
 	int doContinue = 1;
 	do {
 		int solLen = 0;
 		int begin = astar_getIndexByWidth (width, startX, startY);
 		int end = astar_getIndexByWidth (width, goalX, goalY);
-		free (astar_compute (grid, &solLen, width, height, begin, end));
-		if (solLen > optimal) {
+		int *path = astar_context_compute (ctx, grid, &solLen, begin, end);
+		if (path && !stepsAllowed (grid, width, path, solLen)) {
+			fprintf (stderr, "invalid step! In map %s, from (%i,%i) to (%i, %i)\n", mapFileBuf, startX, startY, goalX, goalY);
+			exit (1);
+		}
+		// the scenario costs are for the default movement rules too;
+		// they're rounded, and integer costs round the diagonal, so
+		// bounds on them get a little slack
+		double shortestCost = ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL ? optimalCost : 
+			path ? pathCost (width, path, solLen) : 0;
+		free (path);
+		// the scenario lengths are for the default movement rules
+		if (ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL && solLen > optimal) {
 			fprintf (stderr, "validity error! In map %s, from (%i,%i) to (%i, %i), expected length %i, was length %i\n", mapFileBuf, startX, startY, goalX, goalY, optimal, solLen);
 			exit (1);
 		}
+		if (astar_components_connected (components, begin, end) != (solLen >= 0)) {
+			fprintf (stderr, "components mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, but the components say %s\n", mapFileBuf, startX, startY, goalX, goalY, solLen, solLen >= 0 ? "unreachable" : "reachable");
+			exit (1);
+		}
+		// the same search again, a few nodes at a time
+		astar_search_t *search = astar_begin (grid, width, height, begin, end);
+		if (!search) {
+			fprintf (stderr, "couldn't begin a search\n");
+			exit (1);
+		}
+		while (astar_step (search, 3) == ASTAR_IN_PROGRESS)
+			;
+		int steppedLen = 0;
+		free (astar_finish (search, &steppedLen));
+		if (steppedLen != solLen) {
+			fprintf (stderr, "stepped search mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, stepped search found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, steppedLen);
+			exit (1);
+		}
+		// hierarchical paths needn't be the shortest, but they have to
+		// exist whenever there is one, and go from start to end
+		int hierLen = 0;
+		int *hierPath = astar_hierarchy_compute (hierarchy, &hierLen, begin, end);
+		if ((hierLen >= 0) != (solLen >= 0) ||
+		    (hierPath && (hierPath[0] != end || hierPath[hierLen] != begin ||
+				  !stepsAllowed (grid, width, hierPath, hierLen)))) {
+			fprintf (stderr, "hierarchy mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, hierarchical search found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, hierLen);
+			exit (1);
+		}
+		free (hierPath);
+		// through the cache, and again from halfway along the path,
+		// which the cache should answer with the rest of the path
+		int cacheLen = 0;
+		int *cachePath = astar_cache_compute (cache, grid, 0, &cacheLen, begin, end);
+		if (cacheLen != solLen) {
+			fprintf (stderr, "cache mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, cached search found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, cacheLen);
+			exit (1);
+		}
+		if (cachePath) {
+			long suffixHits = astar_cache_stats (cache)->suffixHits;
+			int half = cachePath[solLen / 2];
+			free (astar_cache_compute (cache, grid, 0, &cacheLen, half, end));
+			if (cacheLen != solLen / 2 || 
+			    (half != begin && astar_cache_stats (cache)->suffixHits != suffixHits + 1)) {
+				fprintf (stderr, "cache suffix mismatch! In map %s, from (%i,%i) to (%i, %i), expected length %i, cache returned length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen / 2, cacheLen);
+				exit (1);
+			}
+		}
+		free (cachePath);
+		// into a buffer, and only the waypoints, with the start first
+		int intoCount = astar_context_compute_into (ctx, grid, begin, end, pathBuf, width * height);
+		int waypoints = astar_context_compute_waypoints (ctx, grid, begin, end, pathBuf, width * height);
+		if (intoCount != (solLen >= 0 ? solLen + 1 : -1) || 
+		    (waypoints >= 0) != (solLen >= 0) || waypoints > intoCount ||
+		    (waypoints > 0 && (pathBuf[0] != begin || pathBuf[waypoints - 1] != end))) {
+			fprintf (stderr, "buffer mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, into a buffer it was %i nodes and %i waypoints\n", mapFileBuf, startX, startY, goalX, goalY, solLen, intoCount, waypoints);
+			exit (1);
+		}
+		int bidirLen = 0;
+		int *bidirPath = astar_context_compute_bidir (ctx, backCtx, grid, &bidirLen, begin, end);
+		if (bidirLen != solLen ||
+		    (bidirPath && (bidirPath[0] != end || bidirPath[bidirLen] != begin))) {
+			fprintf (stderr, "bidirectional mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, bidirectional search found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, bidirLen);
+			exit (1);
+		}
+		free (bidirPath);
+		// weighted paths needn't be the shortest, but have to be within
+		// the weight of it; so do anytime paths, within the bound they
+		// report, and given all the time they need they are the shortest
+		int weightedLen = 0;
+		int *weightedPath = astar_context_compute (weightedCtx, grid, &weightedLen, begin, end);
+		if ((weightedLen >= 0) != (solLen >= 0) ||
+		    (weightedPath && (!stepsAllowed (grid, width, weightedPath, weightedLen) ||
+				      pathCost (width, weightedPath, weightedLen) > 1.2 * shortestCost * 1.001))) {
+			fprintf (stderr, "weighted search mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, weighted search found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, weightedLen);
+			exit (1);
+		}
+		free (weightedPath);
+		// landmarks only change the estimate, not the paths' lengths
+		int landmarkLen = 0, quantizedLen = 0;
+		free (astar_context_compute (landmarkCtx, grid, &landmarkLen, begin, end));
+		free (astar_context_compute (quantizedCtx, grid, &quantizedLen, begin, end));
+		if (landmarkLen != solLen || quantizedLen != solLen) {
+			fprintf (stderr, "landmark mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, with landmarks %i, quantized %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, landmarkLen, quantizedLen);
+			exit (1);
+		}
+		static const int budgets[] = {100, -1};
+		for (int i = 0; i < 2; i++) {
+			int budget = budgets[i];
+			int anytimeLen = 0;
+			double bound = 0;
+			int *anytimePath = astar_context_compute_anytime (ctx, grid, &anytimeLen, begin, end, 2, budget, &bound);
+			if ((anytimeLen >= 0) != (solLen >= 0) ||
+			    (anytimePath && (bound < 1 || bound > 2 || 
+					     (budget < 0 && (bound != 1 || anytimeLen != solLen)) ||
+					     pathCost (width, anytimePath, anytimeLen) > bound * shortestCost * 1.001))) {
+				fprintf (stderr, "anytime search mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, anytime search found length %i with bound %f\n", mapFileBuf, startX, startY, goalX, goalY, solLen, anytimeLen, bound);
+				exit (1);
+			}
+			free (anytimePath);
+		}
+#if ASTAR_MOVEMENT == ASTAR_MOVE_DIAGONAL && ASTAR_LAYOUT == ASTAR_LAYOUT_ROW_MAJOR
+		int plusLen = 0;
+		free (astar_context_compute_jpsplus (ctx, jpsplus, &plusLen, begin, end));
+		if (plusLen != solLen) {
+			fprintf (stderr, "JPS+ mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, JPS+ found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, plusLen);
+			exit (1);
+		}
+		int bitsLen = 0;
+		free (astar_context_compute_bitgrid (ctx, bitgrid, &bitsLen, begin, end));
+		if (bitsLen != solLen) {
+			fprintf (stderr, "bit grid mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, bit grid search found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, bitsLen);
+			exit (1);
+		}
+		int masksLen = 0;
+		free (astar_context_compute_neighbours (ctx, neighbours, &masksLen, begin, end));
+		if (masksLen != solLen) {
+			fprintf (stderr, "neighbourhood mask mismatch! In map %s, from (%i,%i) to (%i, %i), astar_compute found length %i, the masks found length %i\n", mapFileBuf, startX, startY, goalX, goalY, solLen, masksLen);
+			exit (1);
+		}
+#endif
+		if (nQueries == queriesAllocated) {
+			queriesAllocated *= 2;
+			queries = realloc (queries, queriesAllocated * sizeof (astar_query_t));
+			lengths = realloc (lengths, queriesAllocated * sizeof (int));
+		}
+		queries[nQueries] = (astar_query_t) {begin, end};
+		lengths[nQueries] = solLen;
+		nQueries++;
+
 		doContinue = fscanf(scenFile,"%i %s %i %i %i %i %i %i %i %lf\n",
 				     &bucket, mapFileBuf, &width, &height, 
 				     &startX, &startY, &goalX,
-				     &goalY, &optimal, &something);
+				     &goalY, &optimal, &optimalCost);
 	} while (doContinue > 0);
+
+	astar_result_t *results = malloc (nQueries * sizeof (astar_result_t));
+	if (astar_compute_batch (grid, width, height, queries, nQueries, results, 0) != -1) {
+		fprintf (stderr, "batch ran with no threads\n");
+		exit (1);
+	}
+	if (astar_compute_batch (grid, width, height, queries, nQueries, results, 4)) {
+		fprintf (stderr, "batch failed to run every query\n");
+		exit (1);
+	}
+	for (int i = 0; i < nQueries; i++) {
+		if (results[i].length != lengths[i]) {
+			fprintf (stderr, "batch mismatch! In map %s, query %i, astar_compute found length %i, batch found length %i\n", mapFileBuf, i, lengths[i], results[i].length);
+			exit (1);
+		}
+		free (results[i].path);
+
+		int cacheLen = 0;
+		long misses = astar_cache_stats (cache)->misses;
+		free (astar_cache_compute (cache, grid, 0, &cacheLen, queries[i].start, queries[i].end));
+		if (cacheLen != lengths[i] || astar_cache_stats (cache)->misses != misses) {
+			fprintf (stderr, "cache mismatch! In map %s, query %i, astar_compute found length %i, cache returned length %i%s\n", mapFileBuf, i, lengths[i], cacheLen, astar_cache_stats (cache)->misses != misses ? " on a miss" : "");
+			exit (1);
+		}
+	}
+	free (results);
+	free (pathBuf);
+	astar_cache_free (cache);
+
+	// every query again with the paths from an arena; the arena starts
+	// out too small, so it has to grow at first
+	astar_arena_t *arena = astar_arena_create (16);
+	if (!arena) {
+		fprintf (stderr, "couldn't create the arena\n");
+		exit (1);
+	}
+	astar_context_set_path_allocator (ctx, astar_arena_allocator (arena));
+	for (int i = 0; i < nQueries; i++) {
+		int arenaLen = -1;
+		int *arenaPath = astar_context_compute (ctx, grid, &arenaLen, queries[i].start, queries[i].end);
+		if (arenaLen != lengths[i] || 
+		    (arenaPath && (!stepsAllowed (grid, width, arenaPath, arenaLen) || 
+				   astar_arena_used (arena) < (arenaLen + 1) * sizeof (int)))) {
+			fprintf (stderr, "arena mismatch! In map %s, query %i, astar_compute found length %i, the search with the arena found length %i\n", mapFileBuf, i, lengths[i], arenaLen);
+			exit (1);
+		}
+		astar_arena_reset (arena);
+	}
+	astar_context_set_path_allocator (ctx, NULL);
+	astar_arena_free (arena);
+
+	// and the first one with less and less memory to go round: every
+	// search either finds the same path or says it ran out
+	for (int openList = ASTAR_OPEN_BINARY_HEAP; openList <= ASTAR_OPEN_RADIX_HEAP; openList++)
+		for (int blocks = 0; blocks < 48; blocks++) {
+			int left = blocks;
+			astar_allocator_t rationed = { rationedMalloc, rationedRealloc, rationedFree, &left };
+			astar_context_t *rationedCtx = astar_context_create_with_allocator (width, height, openList, &rationed);
+			if (!rationedCtx)
+				continue;
+			int rationedLen = 0;
+			int *rationedPath = astar_context_compute (rationedCtx, grid, &rationedLen, queries[0].start, queries[0].end);
+			if (rationedLen != lengths[0] && (rationedLen != ASTAR_ERROR_NO_MEMORY || rationedPath)) {
+				fprintf (stderr, "out of memory mismatch! In map %s, with %i blocks, astar_compute found length %i, the search found length %i\n", mapFileBuf, blocks, lengths[0], rationedLen);
+				exit (1);
+			}
+			free (rationedPath);
+			astar_context_free (rationedCtx);
+		}
+
+	// and a search a few nodes at a time that gets to the goal, but has
+	// no memory left for the path
+	int left = 1 << 30;
+	astar_allocator_t rationed = { rationedMalloc, rationedRealloc, rationedFree, &left };
+	astar_context_t *rationedCtx = astar_context_create_with_allocator (width, height, ASTAR_OPEN_BINARY_HEAP, &rationed);
+	astar_search_t *rationedSearch = rationedCtx ? astar_context_begin (rationedCtx, grid, queries[0].start, queries[0].end) : NULL;
+	if (!rationedSearch) {
+		fprintf (stderr, "couldn't begin a search\n");
+		exit (1);
+	}
+	astar_status_t status;
+	while ((status = astar_step (rationedSearch, 3)) == ASTAR_IN_PROGRESS)
+		;
+	left = 0;
+	int rationedLen = 0;
+	int *rationedPath = astar_finish (rationedSearch, &rationedLen);
+	if (rationedPath || rationedLen != (status == ASTAR_FOUND ? ASTAR_ERROR_NO_MEMORY : -1)) {
+		fprintf (stderr, "out of memory mismatch! In map %s, the stepped search found length %i with no memory left for the path\n", mapFileBuf, rationedLen);
+		exit (1);
+	}
+	free (rationedPath);
+	astar_context_free (rationedCtx);
+
+	// one search from the first start to every goal, and a distance field
+	// to the first goal that every start then walks along
+	int *goals = malloc (nQueries * sizeof (int));
+	int **multiPaths = malloc (nQueries * sizeof (int *));
+	int *multiLengths = malloc (nQueries * sizeof (int));
+	size_t cells = astar_layout_size (width, height);
+	astar_cost_t *costs = malloc (cells * sizeof (astar_cost_t));
+	unsigned char *next = malloc (cells);
+	for (int i = 0; i < nQueries; i++)
+		goals[i] = queries[i].end;
+	astar_context_compute_multi (ctx, grid, queries[0].start, goals, nQueries, 0, 
+				     multiPaths, multiLengths);
+	if (astar_context_distance_field (backCtx, grid, queries[0].end, costs, next)) {
+		fprintf (stderr, "couldn't compute the distance field\n");
+		exit (1);
+	}
+	for (int i = 0; i < nQueries; i++) {
+		int solLen = 0;
+		free (astar_context_compute (ctx, grid, &solLen, queries[0].start, goals[i]));
+		if (multiLengths[i] != solLen) {
+			fprintf (stderr, "multi-goal mismatch! In map %s, query %i, astar_compute found length %i, multi-goal search found length %i\n", mapFileBuf, i, solLen, multiLengths[i]);
+			exit (1);
+		}
+		free (multiPaths[i]);
+
+		free (astar_context_compute (ctx, grid, &solLen, queries[i].start, queries[0].end));
+		int fieldLen = -1;
+		if (costs[queries[i].start] >= 0) {
+			int x, y;
+			astar_getCoordByWidth (width, queries[i].start, &x, &y);
+			for (fieldLen = 0; next[astar_getIndexByWidth (width, x, y)] != ASTAR_NO_DIRECTION; fieldLen++) {
+				static const int dx[] = {0, 1, 1, 1, 0, -1, -1, -1};
+				static const int dy[] = {-1, -1, 0, 1, 1, 1, 0, -1};
+				int dir = next[astar_getIndexByWidth (width, x, y)];
+				x += dx[dir];
+				y += dy[dir];
+			}
+		}
+		if (fieldLen != solLen) {
+			fprintf (stderr, "distance field mismatch! In map %s, query %i, astar_compute found length %i, the distance field gave length %i\n", mapFileBuf, i, solLen, fieldLen);
+			exit (1);
+		}
+	}
+
+	// multi-goal searches from the first starts again, on the weighted
+	// context and then with landmarks too, neither of which may change
+	// what they find
+	int **weightedPaths = malloc (nQueries * sizeof (int *));
+	int *weightedLengths = malloc (nQueries * sizeof (int));
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1 && !astar_context_set_landmarks (weightedCtx, landmarks)) {
+			fprintf (stderr, "couldn't attach the landmarks\n");
+			exit (1);
+		}
+		for (int j = 0; j < nQueries && j < 32; j++) {
+			int reached = astar_context_compute_multi (ctx, grid, queries[j].start, goals, nQueries, 0, 
+								   multiPaths, multiLengths);
+			int weightedReached = astar_context_compute_multi (weightedCtx, grid, queries[j].start, goals, nQueries, 0, 
+									   weightedPaths, weightedLengths);
+			for (int i = 0; i < nQueries; i++) {
+				if (weightedReached != reached || weightedLengths[i] != multiLengths[i] ||
+				    (multiPaths[i] && pathCost (width, weightedPaths[i], weightedLengths[i]) > 
+				     pathCost (width, multiPaths[i], multiLengths[i]) * 1.001)) {
+					fprintf (stderr, "weighted multi-goal mismatch! In map %s, from query %i's start, to query %i's goal, the search found length %i, on the weighted context length %i\n", mapFileBuf, j, i, multiLengths[i], weightedLengths[i]);
+					exit (1);
+				}
+				free (multiPaths[i]);
+				free (weightedPaths[i]);
+			}
+		}
+	}
+	free (weightedLengths);
+	free (weightedPaths);
+
+	// one incremental planner to the first goal, on a copy of the grid
+	// that the middle of the first path gets walled off in and then
+	// opened up again, with every start in between
+	char *changingGrid = malloc (cells);
+	astar_dstar_t *dstar = changingGrid ? astar_dstar_create (changingGrid, width, height, queries[0].start, queries[0].end) : NULL;
+	if (!dstar) {
+		fprintf (stderr, "couldn't create the incremental planner\n");
+		exit (1);
+	}
+	memcpy (changingGrid, grid, cells);
+	int wall = -1;
+	for (int pass = 0; pass < 3; pass++) {
+		for (int i = 0; i < nQueries; i++) {
+			int solLen = 0, dstarLen = 0;
+			free (astar_context_compute (ctx, changingGrid, &solLen, queries[i].start, queries[0].end));
+			astar_dstar_move_start (dstar, queries[i].start);
+			int *dstarPath = astar_dstar_compute (dstar, &dstarLen);
+			if (dstarLen != solLen ||
+			    (dstarPath && !stepsAllowed (changingGrid, width, dstarPath, dstarLen))) {
+				fprintf (stderr, "incremental planner mismatch! In map %s, query %i, pass %i, astar_compute found length %i, the planner found length %i\n", mapFileBuf, i, pass, solLen, dstarLen);
+				exit (1);
+			}
+			if (pass == 0 && i == 0 && dstarPath)
+				wall = dstarPath[dstarLen / 2];
+			free (dstarPath);
+		}
+
+		if (wall < 0)
+			break;
+		changingGrid[wall] = pass == 0 ? 0 : grid[wall];
+		astar_dstar_changed (dstar, &wall, 1);
+	}
+	astar_dstar_free (dstar);
+	free (changingGrid);
+
+	free (next);
+	free (costs);
+	free (multiLengths);
+	free (multiPaths);
+	free (goals);
+	free (queries);
+	free (lengths);
+
+	astar_hierarchy_free (hierarchy);
+	astar_components_free (components);
+	astar_neighbours_free (neighbours);
+	astar_bitgrid_free (bitgrid);
+	astar_jpsplus_free (jpsplus);
+	astar_context_free (quantizedCtx);
+	astar_context_free (landmarkCtx);
+	astar_landmarks_free (quantizedLandmarks);
+	astar_landmarks_free (landmarks);
+	astar_context_free (weightedCtx);
+	astar_context_free (backCtx);
+	astar_context_free (ctx);
+	astar_map_close (map);
+	free (asciiGrid);
 }
 